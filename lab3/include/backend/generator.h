@@ -4,10 +4,15 @@
 #include "ir/ir.h"
 #include "backend/rv_def.h"
 #include "backend/rv_inst_impl.h"
+#include "backend/regalloc.h"
+#include "opt/profile.h"
 
 #include<map>
+#include<set>
 #include<string>
+#include<unordered_map>
 #include<vector>
+#include<memory>
 #include<fstream>
 #include <cstdint>
 
@@ -16,7 +21,7 @@ namespace backend {
 // it is a map bewteen variable and its mem addr, the mem addr of a local variable can be identified by ($sp + off)
 struct stackVarMap {
     std::map<ir::Operand, int> _table;
-    int next_offset = 4;  // Start from offset 4 to avoid conflicts
+    int next_offset = 0;
 
     /**
      * @brief find the addr of a ir::Operand
@@ -33,6 +38,15 @@ struct stackVarMap {
 };
 
 
+// what a name stands for, see Generator::kindOf
+enum class SymbolKind {
+    scalar,             // a local variable or temporary, in a register or a stack slot
+    globalScalar,
+    globalArray,
+    localArray,         // allocated in the frame of the function
+    pointerParam,       // an array passed to the function, by its address
+};
+
 struct Generator {
     const ir::Program& program;         // the program to gen
     std::ofstream& fout;                 // output file
@@ -40,6 +54,8 @@ struct Generator {
     Generator(ir::Program&, std::ofstream&);
 
     // reg allocate api
+    // getRs* return the register holding the operand, loading it into a scratch register if it is not allocated one,
+    // getRd* return the register to compute the operand in, which storeOperand/fstoreOperand write back
     rv::rvREG getRd(ir::Operand);
     rv::rvFREG fgetRd(ir::Operand);
     rv::rvREG getRs1(ir::Operand);
@@ -47,17 +63,114 @@ struct Generator {
     rv::rvFREG fgetRs1(ir::Operand);
     rv::rvFREG fgetRs2(ir::Operand);
 
+    // registers of the variables of the current function, by the allocator chosen in main.cpp
+    RegAllocator allocator = RegAllocator::linear;
+    // the profile of -fprofile-use, if any, which guides the block layout, see backend::layoutBlocks
+    std::shared_ptr<const opt::Profile> profile;
+    RegAssignment regs;
+    const ir::Function* curFunc = nullptr;
+    int frameSize = 0;
+    int lastPc = -1;                    // the last instruction of curFunc which is not __unuse__
+
+    // names of the global variables, and the kinds of the globals and of the arrays of curFunc
+    std::set<std::string> globalNames;
+    std::unordered_map<std::string, SymbolKind> globalSymbols;
+    std::unordered_map<std::string, SymbolKind> localSymbols;
+
+    // the kind of op in curFunc, from the tables built by gen and gen_func
+    SymbolKind kindOf(const ir::Operand& op) const;
+
     // generate wrapper function
     void gen();
     void gen_func(const ir::Function&);
     void gen_instr(const ir::Instruction&, int pc = 0, const std::string& funcName = "", const ir::Function* func = nullptr);
+    // restore the callee-saved registers, and ra if restoreRa, release the frame and return
+    void gen_epilogue(bool restoreRa);
+    // copy the params of func from a0-a7 and the caller's stack to their registers or stack slots
+    void moveParams(const ir::Function& func);
+
+    // how curFunc keeps ra, set by planReturnAddress
+    bool hasCall = false;               // ra has its slot at 0(sp), a leaf function has no slot for it
+    bool saveRaAtEntry = false;         // ra is saved by the prologue, else right before the calls in raSaves
+    std::set<int> raSaves;
+    std::vector<bool> calledBefore;     // whether a call may have happened before each pc, the last one for the end of function
+    std::set<bool> epilogueUsed;        // the epilogues jumped to, by whether they restore ra
+
+    /**
+     * @brief decide where curFunc saves and restores ra
+     * ra is saved right before the first call on every path, so that paths which never call skip it,
+     * unless one of these calls is in a loop or a return is reached both with and without a call before it,
+     * then it is saved by the prologue; a return restores ra only if a call may have happened before it
+    */
+    void planReturnAddress(const ir::Function& func);
+    // whether instr calls a function, the global initializer is not called when it is evaluated at compile time
+    bool isCall(const ir::Instruction& instr) const;
+    // the epilogue label of curFunc, the one which restores ra or the one which does not
+    std::string epilogueLabel(bool restoreRa) const;
+
+    // uses of every variable of curFunc
+    std::unordered_map<std::string, int> useCount;
+    // the int variables of curFunc which only ever hold a constant, see opt::int_constants
+    std::map<std::string, int> constants;
+    // whether op is an int literal or one of the constants, the immediate operand of the instruction selection
+    bool isConstant(const ir::Operand& op, int& val) const;
+
+    /**
+     * @brief the pc of the conditional _goto which the comparison or _not at pc can be fused into, or -1
+     * the condition must flow through single-use _nots only into that _goto, and no jump may land in between
+    */
+    int fusedGoto(const ir::Function& func, int pc, const std::set<int>& jumpTargets) const;
+    // the branch of the _goto at gotoPc on the condition computed by cond, inverted by the _nots in between
+    void gen_branch(const ir::Instruction& cond, bool negate, int gotoPc, const std::string& funcName);
+
+    /**
+     * @brief give every variable of func which is not in a register, and every local array, its stack slot,
+     * and set frameSize to the exact size of the frame, 16 bytes aligned
+    */
+    void layoutFrame(const ir::Function& func);
+    // rd = value, by li if it fits in 12 bits, by lui and addi otherwise
+    void loadImm(rv::rvREG rd, int32_t value);
+    // rd = rs * c, rd = rs / d and rd = rs % d for a constant c or d != 0, by shifts or a multiply-high where
+    // it pays off, rd is written last so it may be rs, t1 and t3 are clobbered
+    void mulConst(rv::rvREG rd, rv::rvREG rs, int32_t c);
+    void divConst(rv::rvREG rd, rv::rvREG rs, int32_t d);
+    void modConst(rv::rvREG rd, rv::rvREG rs, int32_t d);
+    // sp += delta, through t0 if delta does not fit in an immediate
+    void adjustSp(int delta);
+    // the stack slot at sp + slot as off(base), base is sp, or tmp holding its address if slot does not fit in an immediate
+    void stackSlot(int slot, rv::rvREG tmp, rv::rvREG& base, int& off);
+
+    // the instructions of the current function, cleaned up by backend::peephole before gen_func renders them
+    std::vector<rv::rv_inst> code;
+    void emit(const rv::rv_inst&);
     // stack allocation helper
     stackVarMap svmap;
+
+    // initial words of every global variable, valid if staticGlobalInit
+    std::map<std::string, std::vector<uint32_t>> globalInit;
+    bool staticGlobalInit = false;
+
+    /**
+     * @brief evaluate the function global, which only initializes the global variables, at compile time
+     * @return true if it is straight-line code over constants, the results are put in globalInit
+    */
+    bool evalGlobalInit();
     
     // Helper functions for global/local variable handling
-    bool isGlobalVar(const ir::Operand& op);
-    void loadOperand(const ir::Operand& op, const std::string& reg);
-    void storeOperand(const ir::Operand& op, const std::string& reg);
+    bool isGlobalVar(const ir::Operand& op) const;
+    bool isLocalArray(const ir::Operand& op) const;
+    rv::rvREG getRs(const ir::Operand& op, rv::rvREG scratch);
+    rv::rvFREG fgetRs(const ir::Operand& op, rv::rvFREG scratch);
+    void loadOperand(const ir::Operand& op, rv::rvREG reg);
+    void storeOperand(const ir::Operand& op, rv::rvREG reg);
+    void floadOperand(const ir::Operand& op, rv::rvFREG reg);
+    void fstoreOperand(const ir::Operand& op, rv::rvFREG reg);
+
+    /**
+     * @brief the address of arr[idx] as off(base), base is sp, a register holding the pointer or t3
+     * @param[in] arr: a global array, a local array or a pointer
+    */
+    void elemAddr(const ir::Operand& arr, const ir::Operand& idx, rv::rvREG& base, int& off);
 };
 
 } // namespace backend
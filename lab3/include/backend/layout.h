@@ -0,0 +1,28 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "backend/rv_inst_impl.h"
+
+#include<map>
+#include<string>
+#include<vector>
+#include<cstdint>
+
+namespace backend {
+
+/**
+ * @brief place the basic blocks of the code of a function, after backend::peephole
+ * a jump or branch to a block which only jumps goes straight to its target, and a jump to a small block ending with
+ * a conditional branch, like the test at the top of a loop, is replaced by a copy of it, so that loops are tested at
+ * the bottom; then the blocks are chained so that the heavier successor of each block falls through, the entry first,
+ * the branches are inverted or followed by a jump as the new order requires, and unreachable blocks are dropped;
+ * last, a conditional branch to a label out of its +-4 KiB range becomes an inverted branch over a jump to it
+ * @param name: name of the function, a block which needs a label and has none gets name_bb_<n>
+ * @param counts: execution counts of the blocks starting at some labels, from a profile, may be empty;
+ *      the entry block is counted under name, without counts the blocks keep their original order
+ */
+void layoutBlocks(std::vector<rv::rv_inst>& code, const std::string& name, const std::map<std::string, uint64_t>& counts);
+
+} // namespace backend
+
+#endif
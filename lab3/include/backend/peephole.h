@@ -0,0 +1,20 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "backend/rv_inst_impl.h"
+
+#include<vector>
+
+namespace backend {
+
+/**
+ * @brief clean up the code of a function, before it is rendered
+ * within a basic block, a load from a stack slot which a register already holds becomes a move or is removed,
+ * and a li/la of the value a register already holds is removed,
+ * and moves of a register to itself are removed everywhere, the jumps are left to backend::layoutBlocks
+ */
+void peephole(std::vector<rv::rv_inst>& code);
+
+} // namespace backend
+
+#endif
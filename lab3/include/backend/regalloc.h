@@ -0,0 +1,105 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "ir/ir.h"
+#include "backend/rv_def.h"
+
+#include<map>
+#include<set>
+#include<string>
+#include<vector>
+
+namespace backend {
+
+// registers left to the code generator for operands which are not in a register
+// t0, t1, t2, t3 and ft0, ft1, ft2 are scratch, a0-a7 carry arguments and return values
+const std::vector<rv::rvREG> callerSavedRegs = {rv::rvREG::X29, rv::rvREG::X30, rv::rvREG::X31};
+// a leaf function, which makes no call, may keep its variables in a0-a7 too, after callerSavedRegs
+const std::vector<rv::rvREG> argRegs = {
+    rv::rvREG::X10, rv::rvREG::X11, rv::rvREG::X12, rv::rvREG::X13,
+    rv::rvREG::X14, rv::rvREG::X15, rv::rvREG::X16, rv::rvREG::X17,
+};
+const std::vector<rv::rvREG> calleeSavedRegs = {
+    rv::rvREG::X8, rv::rvREG::X9, rv::rvREG::X18, rv::rvREG::X19, rv::rvREG::X20, rv::rvREG::X21,
+    rv::rvREG::X22, rv::rvREG::X23, rv::rvREG::X24, rv::rvREG::X25, rv::rvREG::X26, rv::rvREG::X27,
+};
+const std::vector<rv::rvFREG> callerSavedFRegs = {
+    rv::rvFREG::F3, rv::rvFREG::F4, rv::rvFREG::F5, rv::rvFREG::F6, rv::rvFREG::F7,
+    rv::rvFREG::F28, rv::rvFREG::F29, rv::rvFREG::F30, rv::rvFREG::F31,
+};
+const std::vector<rv::rvFREG> calleeSavedFRegs = {
+    rv::rvFREG::F8, rv::rvFREG::F9, rv::rvFREG::F18, rv::rvFREG::F19, rv::rvFREG::F20, rv::rvFREG::F21,
+    rv::rvFREG::F22, rv::rvFREG::F23, rv::rvFREG::F24, rv::rvFREG::F25, rv::rvFREG::F26, rv::rvFREG::F27,
+};
+
+// above these sizes of a function, the count of its candidates or the sum of its liveAfter sizes,
+// graphColoring falls back to linearScan
+const size_t maxGraphNodes = 1 << 15;
+const size_t maxGraphLivePairs = 1 << 21;
+
+// the register allocators of the backend
+enum class RegAllocator {
+    none,               // every variable in its stack slot
+    linear,             // linearScan, the default
+    graph,              // graphColoring, the default of -O2
+};
+
+// liveness of the variables of a function which may be put in a register, shared by the allocators
+struct FunctionLiveness {
+    std::map<std::string, bool> candidates;         // scalars of a single register class -> whether it is float
+    std::vector<std::set<std::string>> liveAfter;   // candidates live right after each pc
+    std::set<std::string> liveAtEntry;              // candidates live at the entry, the parameters included
+    std::vector<int> loopDepth;                     // loop nesting depth of each pc
+
+    /**
+     * @param globals: names of the global variables, see opt::global_names
+     */
+    FunctionLiveness(const ir::Function& func, const std::set<std::string>& globals);
+};
+
+// the pcs of a function where a scalar variable is live or defined, as one range [start, end]
+struct LiveInterval {
+    std::string name;
+    bool isFloat;
+    int start, end;
+    bool crossesCall;                   // live after a call which does not define it, so it needs a callee-saved register
+};
+
+// the registers of the scalar variables of a function, the others stay in their stack slots
+struct RegAssignment {
+    std::map<std::string, rv::rvREG> reg;
+    std::map<std::string, rv::rvFREG> freg;
+    std::vector<rv::rvREG> usedCalleeSaved;         // saved by the prologue and restored by the epilogue
+    std::vector<rv::rvFREG> usedCalleeSavedF;
+};
+
+/**
+ * @brief the live intervals of the candidates of func, sorted by start
+ */
+std::vector<LiveInterval> liveIntervals(const ir::Function& func, const FunctionLiveness& live);
+
+/**
+ * @brief linear scan register allocation over liveIntervals(func)
+ * an interval crossing a call gets a callee-saved register, the others prefer a caller-saved one,
+ * when no register is free the interval ending last is spilled to the stack
+ */
+RegAssignment linearScan(const ir::Function& func, const std::set<std::string>& globals, bool leaf);
+
+/**
+ * @brief graph coloring register allocation with iterated register coalescing (George & Appel)
+ * the copies between variables (def/mov/fdef/fmov) are coalesced when the Briggs or George test allows it,
+ * a variable live across a call interferes with the caller-saved registers,
+ * and when the graph can not be simplified, the variable of the least use count weighted by 10^loop depth
+ * per interference is spilled; a function above maxGraphNodes or maxGraphLivePairs gets linearScan instead
+ */
+RegAssignment graphColoring(const ir::Function& func, const std::set<std::string>& globals, bool leaf);
+
+/**
+ * @brief run the allocator on func, RegAllocator::none gives an empty assignment
+ * @param leaf: func makes no call, argRegs are caller-saved then, and an int parameter prefers the one it arrives in
+ */
+RegAssignment allocateRegisters(RegAllocator allocator, const ir::Function& func, const std::set<std::string>& globals, bool leaf);
+
+} // namespace backend
+
+#endif
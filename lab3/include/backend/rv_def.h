@@ -88,13 +88,20 @@ enum class rvOPCODE {
     LW, SW,                                                 // load & store
     BEQ, BNE, BLT, BGE, BLTU, BGEU,                         // conditional branch
     JAL, JALR,                                              // jump
+    LUI,                                                    // upper immediate
 
     // RV32M Multiply Extension
+    MUL, MULH, MULHSU, MULHU, DIV, DIVU, REM, REMU,
 
     // RV32F / D Floating-Point Extensions
+    FLW, FSW,                                               // load & store
+    FADD_S, FSUB_S, FMUL_S, FDIV_S,                         // arithmetic
+    FEQ_S, FLT_S, FLE_S,                                    // compare, the result is in an integer register
+    FCVT_S_W, FCVT_W_S, FMV_X_W, FMV_W_X,                   // conversion and move between register files
 
     // Pseudo Instructions
-    LA, LI, MOV, J,                                         // ...
+    LA, LI, MOV, J, JR, SEQZ, SNEZ, BEQZ, BNEZ, FMV_S,      // ...
+    LABEL,                                                  // not an instruction, the label before the next one
 };
 std::string toString(rvOPCODE r);  // implement this in ur own way
 
@@ -3,18 +3,38 @@
 
 #include "backend/rv_def.h"
 
+#include<cstdint>
+
 namespace rv {
 
 struct rv_inst {
-    rvREG rd, rs1, rs2;         // operands of rv inst
+    rvREG rd = rvREG::X0, rs1 = rvREG::X0, rs2 = rvREG::X0;       // operands of rv inst, rs2 is the value of sw
+    rvFREG frd = rvFREG::F0, frs1 = rvFREG::F0, frs2 = rvFREG::F0; // float operands, frs2 is the value of fsw
     rvOPCODE op;                // opcode of rv inst
     
-    uint32_t imm;               // optional, in immediate inst
-    std::string label;          // optional, in beq/jarl inst
+    int32_t imm = 0;            // optional, in immediate inst
+    std::string label;          // optional, in beq/jarl inst, the symbol of la and of lw from a global
 
     std::string draw() const;
 };
 
+// builders of rv_inst, the operands are given in the order of the assembly syntax
+// the stores take the stored register first: inst(SW, value, base, off) is sw value, off(base)
+rv_inst inst(rvOPCODE op, rvREG rd, rvREG rs1, rvREG rs2);
+rv_inst inst(rvOPCODE op, rvREG rd, rvREG rs1, int32_t imm);
+rv_inst inst(rvOPCODE op, rvREG rd, rvREG rs1);
+rv_inst inst(rvOPCODE op, rvREG rd, int32_t imm);
+rv_inst inst(rvOPCODE op, rvREG rd, const std::string& label);      // la, lw, jal, beqz and bnez
+rv_inst inst(rvOPCODE op, rvREG rs1, rvREG rs2, const std::string& label);
+rv_inst inst(rvOPCODE op, rvREG rs1);
+rv_inst inst(rvOPCODE op, const std::string& label);
+rv_inst inst(rvOPCODE op, rvFREG rd, rvFREG rs1, rvFREG rs2);
+rv_inst inst(rvOPCODE op, rvREG rd, rvFREG rs1, rvFREG rs2);
+rv_inst inst(rvOPCODE op, rvFREG rd, rvFREG rs1);
+rv_inst inst(rvOPCODE op, rvFREG rd, rvREG rs1);
+rv_inst inst(rvOPCODE op, rvREG rd, rvFREG rs1);
+rv_inst inst(rvOPCODE op, rvFREG rd, rvREG rs1, int32_t imm);
+
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -15,6 +15,7 @@ enum class Operator {
     store,      // store    des,    op1,    op2    op2为下标 -> 偏移量  op1为 store 的数组名, des 为被存储的变量
     load,       // load     des,    op1,    op2    op2为下标 -> 偏移量  op1为 load 的数组名, des 为被赋值变量
     getptr,     // op1: arr_name, op2: arr_off
+    memset,     // memset   op1 = arr_name,     op2 = count     set op1[0, count) to zero
 
     def,
     fdef,
@@ -0,0 +1,84 @@
+#ifndef OPT_CFG_H
+#define OPT_CFG_H
+
+#include "ir/ir.h"
+
+#include<vector>
+
+namespace opt {
+
+// a maximal straight-line run of ir::Instruction, only the last one can be a _goto or _return
+struct BasicBlock {
+    int index;                                  // position in CFG::blocks, valid after CFG::update()
+    std::vector<ir::Instruction*> insts;
+    BasicBlock* jump_target = nullptr;          // successor taken by the trailing _goto
+    BasicBlock* fall_through = nullptr;         // successor when not jumping, nullptr after goto/return
+    std::vector<BasicBlock*> preds;
+
+    /**
+     * @brief the trailing _goto/_return of this block
+     * @return nullptr if the block ends with a normal instruction
+     */
+    ir::Instruction* terminator() const;
+
+    /**
+     * @brief successors of this block, jump target comes first
+     */
+    std::vector<BasicBlock*> succs() const;
+};
+
+// control flow graph of a ir::Function
+// jumps are kept as BasicBlock pointers while transforming, 
+// and translated back to [pc, offset] by linearize()
+struct CFG {
+    ir::Function* func;
+    std::vector<BasicBlock*> blocks;            // in layout order, blocks[0] is the entry
+
+    /**
+     * @brief split func->InstVec into basic blocks
+     */
+    explicit CFG(ir::Function* func);
+    ~CFG();
+
+    CFG(const CFG&) = delete;
+    CFG& operator=(const CFG&) = delete;
+
+    /**
+     * @brief create an empty block, placed right before pos in layout order
+     * the caller is responsible for wiring its edges and calling update()
+     */
+    BasicBlock* insert_block_before(BasicBlock* pos);
+
+    /**
+     * @brief recompute BasicBlock::index and BasicBlock::preds after the graph is modified
+     */
+    void update();
+
+    /**
+     * @brief blocks reachable from the entry, in reverse post order
+     */
+    std::vector<BasicBlock*> reverse_post_order() const;
+
+    /**
+     * @brief write blocks back to func->InstVec in layout order, 
+     * recompute the offsets of all _goto and add explicit jumps for broken fall-through edges
+     */
+    void linearize();
+};
+
+// dominator tree, computed with the Cooper-Harvey-Kennedy iterative algorithm
+struct DomTree {
+    std::vector<BasicBlock*> idom;              // indexed by BasicBlock::index, nullptr for entry and unreachable blocks
+    std::vector<bool> reachable;
+
+    explicit DomTree(const CFG&);
+
+    /**
+     * @brief whether a dominates b, a block dominates itself
+     */
+    bool dominates(const BasicBlock* a, const BasicBlock* b) const;
+};
+
+} // namespace opt
+
+#endif
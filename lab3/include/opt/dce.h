@@ -0,0 +1,25 @@
+#ifndef OPT_DCE_H
+#define OPT_DCE_H
+
+#include "ir/ir.h"
+
+#include<set>
+#include<string>
+
+namespace opt {
+
+/**
+ * @brief dead code elimination, remove instructions without side effects whose result is never used
+ * @param globals: names of global variables, writes to them are never removed
+ * @return the number of removed instructions
+ */
+int dce(ir::Function&, const std::set<std::string>& globals);
+
+/**
+ * @brief run dce on every function of the program
+ */
+int dce(ir::Program&);
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef OPT_INLINER_H
+#define OPT_INLINER_H
+
+#include "ir/ir.h"
+#include "opt/profile.h"
+
+namespace opt {
+
+/**
+ * @brief default max instruction count of a callee which is inlined at every call site
+ */
+const int default_inline_threshold = 32;
+
+/**
+ * @brief with a profile, a callee taking at least 1/hot_call_share of all calls is hot and
+ * its threshold is multiplied by hot_inline_factor
+ */
+const int hot_call_share = 8;
+const int hot_inline_factor = 4;
+
+/**
+ * @brief function inlining
+ * replace the calls of small non-recursive functions (and of functions called only once) by a copy of the callee:
+ * locals and temporaries are renamed, parameters are bound by def/fdef/getptr, _return becomes a move plus a jump,
+ * and the callee's allocs are hoisted to the caller's entry, shared by all inlined copies of the same callee
+ * @param threshold: max instruction count of a callee to be inlined at every call site
+ * @param profile: if given, a callee which was never called is not copied to several call sites,
+ *                 and a hot callee may be up to hot_inline_factor times the threshold
+ * @return the number of inlined call sites
+ */
+int inline_functions(ir::Program&, int threshold = default_inline_threshold, const Profile* profile = nullptr);
+
+} // namespace opt
+
+#endif
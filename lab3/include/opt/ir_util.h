@@ -0,0 +1,72 @@
+#ifndef OPT_IR_UTIL_H
+#define OPT_IR_UTIL_H
+
+#include "ir/ir.h"
+
+#include<map>
+#include<set>
+#include<string>
+#include<vector>
+
+namespace opt {
+
+/**
+ * @brief whether the operand names a variable (not a literal, not null)
+ */
+bool is_var(const ir::Operand&);
+
+/**
+ * @brief collect the variable operands read by an instruction
+ */
+std::vector<ir::Operand> uses_of(const ir::Instruction*);
+
+/**
+ * @brief the variable written by an instruction
+ * @return nullptr if the instruction does not write a variable (store, goto, return, void call...)
+ */
+const ir::Operand* def_of(const ir::Instruction*);
+
+/**
+ * @brief whether the call instruction is calling a sylib function
+ */
+bool is_lib_call(const ir::Instruction*);
+
+/**
+ * @brief names of all global variables of the program
+ */
+std::set<std::string> global_names(const ir::Program&);
+
+/**
+ * @brief find the int variables which are defined exactly once in the function, by a def/mov from an int literal or from another such variable,
+ * or by an add/sub/mul of two of them
+ * @param globals: names of the global variables, which other functions may change, so they are never constants
+ * @return map from variable name to its value
+ */
+std::map<std::string, int> int_constants(const ir::Function&, const std::set<std::string>& globals);
+
+/**
+ * @brief whether the operand is an int constant, either an IntLiteral or a variable in consts
+ * @param[out] val: the value of the constant
+ */
+bool get_int_constant(const ir::Operand&, const std::map<std::string, int>& consts, int& val);
+
+/**
+ * @brief parse the relative offset of a _goto
+ */
+int goto_offset(const ir::Instruction*);
+
+/**
+ * @brief a copy of the instruction, a ir::CallInst is copied with its arguments
+ */
+ir::Instruction* clone(const ir::Instruction*);
+
+/**
+ * @brief create a unique variable name for values introduced by optimization passes, 
+ * it will never conflict with names from frontend::Analyzer (t0, t1, ... and xx_scope_n)
+ * @param hint: a short tag of the pass, e.g. "licm"
+ */
+std::string fresh_name(const std::string& hint);
+
+} // namespace opt
+
+#endif
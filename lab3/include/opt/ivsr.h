@@ -0,0 +1,20 @@
+#ifndef OPT_IVSR_H
+#define OPT_IVSR_H
+
+#include "ir/ir.h"
+
+namespace opt {
+
+/**
+ * @brief induction variable strength reduction for array accesses
+ * a basic induction variable i is a variable whose only definition in a loop is i = i + c (c is a constant),
+ * an array access A[a*i + b] (a is a constant, b is loop invariant) inside the loop is rewritten into 
+ * a pointer p = A + a*i + b, initialized in the preheader by getptr and advanced by getptr p, p, a*c
+ * right after i is updated, the access becomes A'[0] and the address arithmetic is left to dce
+ * @return the number of rewritten loads and stores
+ */
+int ivsr(ir::Program&);
+
+} // namespace opt
+
+#endif
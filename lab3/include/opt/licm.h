@@ -0,0 +1,18 @@
+#ifndef OPT_LICM_H
+#define OPT_LICM_H
+
+#include "ir/ir.h"
+
+namespace opt {
+
+/**
+ * @brief loop-invariant code motion
+ * for every natural loop (inner loops first), move the instructions whose operands do not change 
+ * inside the loop into the loop's preheader, so they are executed once instead of once per iteration
+ * @return the number of hoisted instructions
+ */
+int licm(ir::Program&);
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef OPT_LIVENESS_H
+#define OPT_LIVENESS_H
+
+#include "opt/cfg.h"
+
+#include<set>
+#include<string>
+#include<vector>
+
+namespace opt {
+
+// live variable analysis on variable names
+// global variables are treated as read at every _return, and read & written by every non-lib call
+struct Liveness {
+    std::vector<std::set<std::string>> live_in;     // indexed by BasicBlock::index
+    std::vector<std::set<std::string>> live_out;
+
+    /**
+     * @param cfg: the analyzed function
+     * @param globals: names of global variables, see opt::global_names
+     */
+    Liveness(const CFG& cfg, const std::set<std::string>& globals);
+
+    /**
+     * @brief transfer a live set backward through one instruction
+     * @param[in, out] live: live variables after inst, becomes live variables before inst
+     */
+    static void step(const ir::Instruction* inst, std::set<std::string>& live, const std::set<std::string>& globals);
+};
+
+} // namespace opt
+
+#endif
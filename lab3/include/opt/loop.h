@@ -0,0 +1,70 @@
+#ifndef OPT_LOOP_H
+#define OPT_LOOP_H
+
+#include "opt/cfg.h"
+
+#include<set>
+#include<vector>
+
+namespace opt {
+
+// a natural loop: the header plus every block that reaches a back edge source without passing the header
+struct Loop {
+    BasicBlock* header;
+    std::set<BasicBlock*> blocks;
+    std::vector<BasicBlock*> latches;           // sources of the back edges
+    Loop* parent = nullptr;
+    std::vector<Loop*> children;
+    int depth = 1;                              // outermost loops have depth 1
+
+    bool contains(const BasicBlock* bb) const;
+
+    /**
+     * @brief blocks inside the loop that have a successor outside of it, in layout order
+     */
+    std::vector<BasicBlock*> exiting_blocks(const CFG&) const;
+
+    /**
+     * @brief blocks outside the loop that are successors of loop blocks, in layout order
+     */
+    std::vector<BasicBlock*> exit_blocks(const CFG&) const;
+};
+
+// the loop nest forest of a function
+struct LoopInfo {
+    std::vector<Loop*> loops;                   // all loops, inner loops come before the loops containing them
+    std::vector<Loop*> top_level;               // roots of the forest
+    std::vector<Loop*> innermost;               // indexed by BasicBlock::index, nullptr if not in any loop
+
+    /**
+     * @brief detect natural loops by back edges (an edge whose target dominates its source)
+     */
+    LoopInfo(const CFG&, const DomTree&);
+    ~LoopInfo();
+
+    LoopInfo(const LoopInfo&) = delete;
+    LoopInfo& operator=(const LoopInfo&) = delete;
+
+    /**
+     * @brief the innermost loop containing bb, nullptr if bb is not in a loop
+     */
+    Loop* loop_of(const BasicBlock* bb) const;
+
+    /**
+     * @brief loop nesting depth of bb, 0 if bb is not in a loop
+     */
+    int depth_of(const BasicBlock* bb) const;
+};
+
+/**
+ * @brief make sure the loop has a preheader: a block outside the loop, laid out right before the header,
+ * which is the only predecessor of the header from outside the loop.
+ * all edges entering the loop are redirected to it, and it is added to every enclosing loop.
+ * LoopInfo::innermost and DomTree are NOT updated, the analyses should be rebuilt after it
+ * @return the preheader
+ */
+BasicBlock* insert_preheader(CFG& cfg, Loop* loop);
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef OPT_PASS_MANAGER_H
+#define OPT_PASS_MANAGER_H
+
+#include "ir/ir.h"
+#include "opt/inliner.h"
+#include "opt/unroll.h"
+
+#include<set>
+#include<memory>
+#include<string>
+#include<vector>
+#include<functional>
+
+namespace opt {
+
+// options of the optimization pipeline, set from the command line
+struct PassOptions {
+    int level = 0;                                          // -O0, -O1, -O2
+    int inline_threshold = default_inline_threshold;        // -finline-threshold=<n>
+    int unroll_factor = default_unroll_factor;              // -funroll=<n>
+    std::set<std::string> enabled;                          // -f<pass>, added to the pipeline of any level
+    std::set<std::string> disabled;                         // -fno-<pass>, removed from the pipeline
+    bool time_passes = false;                               // -time-passes
+    bool verify = false;                                    // -verify-each
+    std::string profile_file;                               // -fprofile-use=<file>, written by -e -profile
+    std::shared_ptr<const Profile> profile;                 // profile_file, loaded by PassManager
+
+    /**
+     * @brief parse one command line option
+     * @return false if it is not an optimization option
+     */
+    bool parse(const std::string& arg);
+};
+
+// a transformation of the whole program, returns the number of changes it made
+struct Pass {
+    std::string name;
+    std::function<int(ir::Program&)> run;
+};
+
+// runs an ordered list of passes, optionally timing them and verifying the IR after each of them
+class PassManager {
+public:
+    explicit PassManager(const PassOptions& options);
+
+    /**
+     * @brief the pipeline for options.level, with -f<pass>/-fno-<pass> applied
+     */
+    const std::vector<Pass>& pipeline() const;
+
+    /**
+     * @brief names of all known passes, in pipeline order
+     */
+    static std::vector<std::string> pass_names();
+
+    /**
+     * @brief run the pipeline on program, report to stderr if time_passes is set
+     * with verify, an invalid IR after a pass aborts, an invalid input is reported and not checked further
+     */
+    void run(ir::Program& program);
+
+private:
+    PassOptions options;
+    std::vector<Pass> passes;
+};
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef OPT_PROFILE_H
+#define OPT_PROFILE_H
+
+#include<map>
+#include<string>
+#include<vector>
+#include<cstdint>
+
+namespace opt {
+
+// execution counts of a function, as recorded by the executor
+struct FunctionCounts {
+    uint64_t calls = 0;
+    std::vector<uint64_t> counts;                       // times each instruction is executed, indexed by pc
+    std::map<int, std::pair<uint64_t, uint64_t>> gotos; // pc of a _goto -> (taken, not taken)
+};
+
+/**
+ * @brief a profile written by `compiler <src> -e -o <out> -profile`, used as profile-guided input of the passes
+ * counts are indexed by the pc of the IR the profile was recorded from, so they only apply to a function whose
+ * instruction count is still the same, call counts apply as long as the function exists
+ */
+struct Profile {
+    std::map<std::string, FunctionCounts> functions;
+
+    /**
+     * @brief read a profile file
+     * @return false if the file can not be read or is not a profile
+     */
+    bool load(const std::string& path);
+
+    /**
+     * @return the recorded calls of function name, -1 if it is not in the profile
+     */
+    long long calls(const std::string& name) const;
+};
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef OPT_SROA_H
+#define OPT_SROA_H
+
+#include "ir/ir.h"
+
+namespace opt {
+
+/**
+ * @brief max element count of a local array to be replaced by scalars
+ */
+const int max_sroa_size = 32;
+
+/**
+ * @brief scalar replacement of small local arrays
+ * an alloc'ed array which is only accessed by load/store with constant indices (and memset) is replaced by one variable 
+ * per element: the alloc becomes zero defs of the elements, store/load become mov, memset becomes zero movs, 
+ * the array itself disappears
+ * @return the number of replaced arrays
+ */
+int sroa(ir::Program&);
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef OPT_TRE_H
+#define OPT_TRE_H
+
+#include "ir/ir.h"
+
+namespace opt {
+
+/**
+ * @brief tail recursion elimination
+ * a self call whose result is returned right away (call t, f(args); [mov r, t;] return t|r, or a void call followed 
+ * by return) is rewritten into assignments of args to the parameters and a jump back to the function entry,
+ * so the recursion runs as a loop in constant stack space; the allocs of the function move before the loop, and a call
+ * passing a pointer into one of them is kept, as the levels would share that array
+ * @return the number of eliminated calls
+ */
+int tre(ir::Program&);
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef OPT_UNROLL_H
+#define OPT_UNROLL_H
+
+#include "ir/ir.h"
+
+namespace opt {
+
+/**
+ * @brief default unroll factor of -O1
+ */
+const int default_unroll_factor = 4;
+
+/**
+ * @brief loop unrolling for loops made of a header which tests `iv cmp bound` and a single body block,
+ * where iv is a basic induction variable and bound is loop invariant
+ * - if the trip count is a known constant and the unrolled code is small, the loop is replaced by trip copies of the body
+ * - otherwise a copy of the loop with factor copies of the body is placed in front of the original one,
+ *   it runs while iv + (factor - 1) * step still passes the test, the original loop handles the remaining iterations
+ * @param factor: unroll factor, loops are not unrolled if it is less than 2
+ * @return the number of unrolled loops
+ */
+int unroll(ir::Program&, int factor = default_unroll_factor);
+
+} // namespace opt
+
+#endif
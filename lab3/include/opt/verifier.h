@@ -0,0 +1,20 @@
+#ifndef OPT_VERIFIER_H
+#define OPT_VERIFIER_H
+
+#include "ir/ir.h"
+
+#include<string>
+
+namespace opt {
+
+/**
+ * @brief check the structural invariants of the IR that passes rely on:
+ * every _goto has a literal offset inside its function, every call names an existing function with matching arguments,
+ * array operators work on pointers, a variable keeps one type inside a function, and no function falls off its end
+ * @return a description of the first broken invariant, empty if the program is well formed
+ */
+std::string verify(const ir::Program&);
+
+} // namespace opt
+
+#endif
@@ -15,8 +15,8 @@
 #include"ir/ir.h"
 
 #include<map>
-#include<stack>
 #include<string>
+#include<vector>
 #include<cstdint>
 #include<fstream>
 #include<iostream>
@@ -28,6 +28,11 @@ namespace ir {
 extern FILE* reopen_output_file;
 extern FILE* reopen_input_file;
 
+/**
+ * @brief write out what the put* functions buffered, Executor::run() calls it before it returns
+ */
+void flush_output();
+
 // helper function
 
 /**
@@ -50,17 +55,71 @@ struct Value {
     _4bytes _val;
 };
 
+// an operand resolved before execution: a slot of the frame, a slot of the global variables or a decoded literal
+struct Slot {
+    enum Kind { none, local, global, imm };
+    Kind kind = none;
+    int index = 0;
+    Value val;                              // the value of a literal
+};
+
+// an instruction whose operands are resolved, so executing it does not look up any name
+struct PreparedInst {
+    Operator op;
+    Slot op1, op2, des;
+    std::vector<Slot> args;                 // arguments of a call
+    int callee = -1;                        // index of the called function in Executor::functions, -1 for a lib function
+    uint32_t target = 0;                    // the pc a goto jumps to
+    const Instruction* inst;                // the original instruction
+};
+
+// an instruction of the threaded interpreter, specialised by the kind of its operands,
+// code[pc] is the instruction at the same pc of the ir, a superinstruction also executes the following ones
+struct Code {
+    int opcode;
+    const void* label;                      // address of the handler, when dispatching by computed goto
+    int des, op1, op2;                      // frame slots
+    int des2;                               // frame slot of the `not` of a negated compare-and-branch
+    _4bytes imm;                            // the immediate operand
+    Value* gvar;                            // the global array of a load/store
+    uint32_t target;                        // the pc a jump goes to
+};
+
+// a function ready to be executed
+struct PreparedFunction {
+    const ir::Function* pfunc;
+    std::vector<PreparedInst> insts;
+    std::vector<Code> code;                 // the same function for the threaded interpreter
+    std::vector<Value> frame;               // initial frame, a zero Value of the right type for every local variable
+    std::vector<int> params;                // frame slots of the parameters
+};
+
+// execution counts of a function, collected in profile mode
+struct FunctionProfile {
+    uint64_t calls = 0;
+    std::vector<uint64_t> counts;           // times each instruction is executed
+    std::vector<uint64_t> taken;            // times each _goto jumps, 0 for other instructions
+};
+
+// per instruction trace of the executor, off by default
+struct TraceOptions {
+    bool enabled = false;                   // print every executed instruction to Executor::out
+    uint64_t limit = 0;                     // stop printing after this many instructions, 0 for no limit
+    size_t ring = 0;                        // keep the last ring instructions, dumped to stderr if the executor aborts
+};
+
 // definition of function context
 struct Context {
     uint32_t pc;                            // program counter of a function
-    Value* retval_addr;                   // if it's not nullptr, this addr will be written when exit a context, 
-    std::map<std::string, Value> mem;
+    size_t base;                            // the frame is Executor::stack[base, base + frame size)
+    Slot retval;                            // the caller's operand the return value is written to, none if unused
     const ir::Function* pfunc;              // executing which function 
+    const PreparedFunction* prepared;
 
     /**
      * @brief constructor
      */
-    Context(const ir::Function*);
+    Context(const PreparedFunction*, size_t base);
 };
 
 
@@ -69,11 +128,26 @@ struct Executor {
     std::ostream& out;
 
     const ir::Program* program;
-    std::map<std::string, Value> global_vars;
+    std::vector<Value> global_vars;                 // indexed by Slot::index
+    std::map<std::string, int> global_index;        // only used while preparing
+    std::vector<PreparedFunction> functions;        // the prepared program->functions, in the same order
+
+    // the frames of all active calls, one after another, the memory is reused by later calls
+    std::vector<Value> stack;
+    size_t stack_top;
+
+    bool profiling = false;                         // count executions, see FunctionProfile
+    std::vector<FunctionProfile> profile;           // indexed as functions
+
+    TraceOptions trace;
+    uint64_t traced = 0;                            // instructions printed so far
+    std::vector<std::pair<int, uint32_t>> trace_ring;   // (function, pc) of the last trace.ring instructions
+    size_t ring_pos = 0;                            // next entry of trace_ring to overwrite
 
-    Context* cur_ctx;
+    Context* cur_ctx;                               // always cxt_stack.back()
     Instruction* cur_inst;
-    std::stack<Context*> cxt_stack;
+    std::vector<Context> cxt_stack;
+    Value main_retval;
 
     /**
      * @brief constructor
@@ -93,27 +167,78 @@ struct Executor {
      */
     bool exec_ir(size_t n = 1);
 
+    /**
+     * @brief write a readable summary of the profile: hottest functions, hottest loops and the instruction mix
+     */
+    void write_profile_report(std::ostream&) const;
+
+    /**
+     * @brief write the profile as json, every function with its call count, per instruction counts and 
+     *        the taken/not taken counts of its _goto instructions, see opt::Profile for the reader
+     */
+    void write_profile(std::ostream&) const;
+
+    /**
+     * @brief write the instructions kept by trace.ring, the oldest first
+     */
+    void dump_trace_ring(std::ostream&) const;
+
 private:
     /**
-     * @brief find the Value of Operand.name in current context, and check if the type match, create a temp Value for Literal operand
-     * @return Value : return the Value 
+     * @brief allocate the global variables and resolve every operand of the program to a Slot, check the types on the way
+     */
+    void prepare();
+
+    /**
+     * @brief translate the prepared instructions of pf into pf.code
+     */
+    void translate(PreparedFunction& pf);
+
+    /**
+     * @brief run the program with the threaded interpreter until main returns,
+     *        the instructions without a specialised handler are executed by exec_ir
+     */
+    void run_threaded();
+
+    /**
+     * @brief print and/or remember the instruction at pc of the current context, as trace says
+     */
+    void trace_inst();
+
+    /**
+     * @brief push a new frame of pf, with its slots zeroed, and make it the current context
+     * @param[in] retval: the operand of the current context which receives the return value
+     */
+    void push_frame(const PreparedFunction& pf, const Slot& retval);
+
+    /**
+     * @brief resolve the operand of function pf to a Slot, a new local variable gets a new frame slot
+     * @param[in] locals: frame slots of the local variables of pf seen so far
+     */
+    Slot resolve(const Operand&, PreparedFunction& pf, std::map<std::string, int>& locals);
+
+    /**
+     * @brief the Value of a resolved source operand
+     */
+    const Value& src(const Slot&) const;
+
+    /**
+     * @brief the Value of a resolved source operand of the frame at base
      */
-    Value find_src_operand(Operand);
+    const Value& src(const Slot&, size_t base) const;
 
     /**
-     * @brief find the Value of Operand.name in current context, and check if the type match
-     *        if do not find one, then create a new operand
-     * @return Value* : return poniter of the Value 
+     * @brief the Value of a resolved destination operand
      */
-    Value* get_des_operand(Operand);
+    Value& des(const Slot&);
 
     /**
-     * @brief if the ir::CallInst is calling a lib function, then execute the function and return true
-     * @param[in]   callinst: the ir::CallInst  
+     * @brief if the call is calling a lib function, then execute the function and return true
+     * @param[in]   call: the prepared call
      * @param[out]  p_retval: the return value address
-     * @return bool : return true if the callinst calling a lib function
+     * @return bool : return true if the call is calling a lib function
     */
-    bool exec_lib_function(const ir::CallInst* callinst, Value* p_retval);
+    bool exec_lib_function(const PreparedInst& call, Value* p_retval);
 };
 
 
@@ -4,6 +4,7 @@
 #include"ir/ir.h"
 #include"tools/ir_executor.h"
 #include"backend/generator.h"
+#include"opt/pass_manager.h"
 
 #include<string>
 #include<vector>
@@ -27,11 +28,32 @@ using std::vector;
  *  -all[FIXME]
  * 
  * opt:
- * [FIXME]
+ *  -O0: no optimization (default)
+ *  -O1: tail recursion elimination, function inlining, scalar replacement of small arrays, 
+ *       loop-invariant code motion, induction variable strength reduction, loop unrolling, dead code elimination
+ *  -O2: -O1, then loop-invariant code motion and dead code elimination again
+ *  -f<pass>, -fno-<pass>: add/remove a pass (tre, inline, sroa, licm, ivsr, unroll, dce) to/from the pipeline
+ *  -finline-threshold=<n>: max instruction count of a function to be inlined at every call site
+ *  -funroll=<n>: loop unroll factor, default 4, 1 disables loop unrolling
+ *  -time-passes: print time and instruction count change of every pass to stderr
+ *  -verify-each: verify the IR after every pass
+ *  -fprofile-use=<file>: guide the passes, and the block layout of -S, by a profile written by -profile
+ * 
+ * profile (with -e):
+ *  -profile, -profile=<file>: count executed instructions, calls and taken _gotos, print a report to stderr and
+ *       write the profile to <file>, <output_filename>.profile.json by default
+ * 
+ * trace (with -e), off by default:
+ *  -trace, -trace=<n>: print the program, then every executed instruction to stdout, stop after n instructions
+ *  -trace-ring=<n>: keep the last n executed instructions, print them to stderr if the executor aborts
+ * 
+ * register allocation (with -S):
+ *  -regalloc=<none|linear|graph>: keep every variable on the stack, linear scan (default), or graph coloring
+ *       with copy coalescing (default of -O2)
  */
 
 int main(int argc, char** argv) {
-    assert((argc == 5 || argc == 6) && "command line should be: compiler <src_filename> -step -o <output_filename> [opt]");
+    assert(argc >= 5 && "command line should be: compiler <src_filename> -step -o <output_filename> [opt]");
     string src = argv[1];
     string step = argv[2];
     string des = argv[4];
@@ -63,6 +85,39 @@ int main(int argc, char** argv) {
     
     frontend::Analyzer analyzer;
     auto program = analyzer.get_ir_program(node);
+
+    // compiler <src_filename> -step -o <output_filename> [opt]
+    opt::PassOptions pass_options;
+    bool profile = false;
+    string profile_file = des + ".profile.json";
+    ir::TraceOptions trace;
+    string regalloc;
+    for(int i = 5; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "-profile" || arg.compare(0, 9, "-profile=") == 0) {
+            profile = true;
+            if(arg.size() > 9) profile_file = arg.substr(9);
+            continue;
+        }
+        if(arg == "-trace" || arg.compare(0, 7, "-trace=") == 0) {
+            trace.enabled = true;
+            if(arg.size() > 7) trace.limit = std::stoull(arg.substr(7));
+            continue;
+        }
+        if(arg.compare(0, 12, "-trace-ring=") == 0) {
+            trace.ring = std::stoul(arg.substr(12));
+            continue;
+        }
+        if(arg.compare(0, 10, "-regalloc=") == 0) {
+            regalloc = arg.substr(10);
+            assert((regalloc == "none" || regalloc == "linear" || regalloc == "graph") && "unknown register allocator");
+            continue;
+        }
+        bool ok = pass_options.parse(arg);
+        assert(ok && "unknown option");
+        (void)ok;
+    }
+    opt::PassManager(pass_options).run(program);
     
     // compiler <src_filename> -s2 -o <output_filename>
     if(step == "-s2") {
@@ -77,13 +132,33 @@ int main(int argc, char** argv) {
         ir::reopen_input_file =  fopen(input_file_name.c_str(), "r");
 
         auto executor = ir::Executor(&program);
-        std::cout << program.draw() << "--------------------------- Executor::run() ---------------------------" << std::endl;
+        executor.profiling = profile;
+        executor.trace = trace;
+        if(trace.enabled) {
+            std::cout << program.draw() << "--------------------------- Executor::run() ---------------------------" << std::endl;
+        }
         fprintf(ir::reopen_output_file, "\n%d", (uint8_t)executor.run());
+        if(profile) {
+            executor.write_profile_report(std::cerr);
+            std::ofstream profile_output(profile_file);
+            assert(profile_output.is_open() && "profile file can not open");
+            executor.write_profile(profile_output);
+        }
     }
 
     // compiler <src_filename> -e -o <output_filename>
     if(step == "-S") {
         backend::Generator generator(program, output_file);
+        if(regalloc.empty()) regalloc = pass_options.level >= 2 ? "graph" : "linear";
+        generator.allocator = regalloc == "none" ? backend::RegAllocator::none
+                            : regalloc == "graph" ? backend::RegAllocator::graph : backend::RegAllocator::linear;
+        if(!pass_options.profile_file.empty()) {
+            auto profile = std::make_shared<opt::Profile>();
+            bool ok = profile->load(pass_options.profile_file);
+            assert(ok && "-fprofile-use=<file>: can not read the profile");
+            (void)ok;
+            generator.profile = profile;
+        }
         generator.gen();
     }
     return 0;
@@ -1,7 +1,15 @@
 #include"backend/generator.h"
+#include"backend/peephole.h"
+#include"backend/layout.h"
+#include"opt/ir_util.h"
 #include <cstdint>
 #include <set>
 #include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <climits>
 
 #include<assert.h>
 
@@ -11,590 +19,1182 @@
 backend::Generator::Generator(ir::Program& p, std::ofstream& f): program(p), fout(f) {}
 
 void backend::Generator::gen() {
-    // generate data section
+    globalNames = opt::global_names(program);
+    globalSymbols.clear();
+    for (const auto& gv : program.globalVal) {
+        globalSymbols[gv.val.name] = gv.maxlen > 0 ? SymbolKind::globalArray : SymbolKind::globalScalar;
+    }
+    // generate data section, with the initial values if they are known at compile time
+    staticGlobalInit = evalGlobalInit();
     fout << ".data\n";
     for (const auto& gv : program.globalVal) {
-        if (gv.maxlen > 0) {
-            // array: allocate space and zero-initialize
-            fout << gv.val.name << ": .space " << gv.maxlen * 4 << "\n";
-        } else {
-            // scalar: check if it has initial value in program
-            // for now, default to 0 - could be enhanced to parse initial values
-            fout << gv.val.name << ": .word 0\n";
+        std::vector<uint32_t> words(gv.maxlen > 0 ? gv.maxlen : 1, 0);
+        if (staticGlobalInit) words = globalInit[gv.val.name];
+        bool isFloat = gv.val.type == ir::Type::Float || gv.val.type == ir::Type::FloatPtr;
+        fout << gv.val.name << ":\n";
+        // runs of zero words become .zero
+        for (size_t i = 0; i < words.size(); ) {
+            size_t j = i;
+            while (j < words.size() && words[j] == 0) j++;
+            if (j > i) {
+                fout << "  .zero " << (j - i) * 4 << "\n";
+                i = j;
+                continue;
+            }
+            float f;
+            std::memcpy(&f, &words[i], 4);
+            if (isFloat && std::isfinite(f)) {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "%.9g", f);
+                fout << "  .float " << buf << "\n";
+            } else {
+                fout << "  .word " << static_cast<int32_t>(words[i]) << "\n";
+            }
+            i++;
         }
     }
     // generate text section
     fout << ".text\n";
     fout << ".global main\n"; // make sure main is globally visible
     for (const auto& func : program.functions) {
+        // the initial values are already in .data, main does not call global then
+        if (staticGlobalInit && func.name == "global") continue;
         gen_func(func);
     }
 }
 
-void backend::Generator::gen_func(const ir::Function& func) {
-    // reset stack map
-    svmap = stackVarMap();
-    fout << func.name << ":\n";    // pre-allocate a larger stack frame for complex functions (within RISC-V immediate limits)
-    int frame = 2044;  // 使用2044字节，在RISC-V立即数范围内(-2048到+2047)
-    // prologue: allocate stack frame and save return address
-    fout << "  addi sp, sp, -" << frame << "\n";
-    fout << "  sw ra, " << frame - 4 << "(sp)\n";// handle function parameters
-    // First 8 params come from argument registers a0-a7, save to stack
-    for (size_t i = 0; i < func.ParameterList.size() && i < 8; i++) {
-        std::string argReg = "a" + std::to_string(i);
-        int paramOff = svmap.find_operand(func.ParameterList[i]);
-        fout << "  sw " << argReg << ", " << paramOff << "(sp)   # save param " << func.ParameterList[i].name << "\n";
-    }
-    
-    // Params 8+ are already on stack from caller, but we need to map them
-    // to our local stack space for consistent access
-    if (func.ParameterList.size() > 8) {
-        for (size_t i = 8; i < func.ParameterList.size(); i++) {
-            // Calculate caller's stack offset for this parameter
-            // The caller pushed args in reverse order, so:
-            // arg[8] is at caller_sp + 0, arg[9] at caller_sp + 4, etc.
-            int callerArgOffset = (i - 8) * 4;
-            int paramOff = svmap.find_operand(func.ParameterList[i]);
-              // Copy from caller's stack to our local stack space
-            // Use register to handle large offsets that exceed immediate range
-            int totalOffset = frame + callerArgOffset;
-            if (totalOffset > 2047) {
-                fout << "  li t1, " << totalOffset << "\n";
-                fout << "  add t1, sp, t1\n";
-                fout << "  lw t0, 0(t1)  # load param " << i << " from caller stack\n";
-            } else {
-                fout << "  lw t0, " << totalOffset << "(sp)  # load param " << i << " from caller stack\n";
-            }
-            fout << "  sw t0, " << paramOff << "(sp)   # save param " << func.ParameterList[i].name << "\n";
+bool backend::Generator::evalGlobalInit() {
+    const ir::Function* init = nullptr;
+    for (const auto& func : program.functions) {
+        if (func.name == "global") init = &func;
+    }
+    globalInit.clear();
+    for (const auto& gv : program.globalVal) {
+        globalInit[gv.val.name] = std::vector<uint32_t>(gv.maxlen > 0 ? gv.maxlen : 1, 0);
+    }
+    if (!init) return true;
+
+    // values of the temporaries of global as raw words, and whether they are floats
+    std::map<std::string, std::pair<uint32_t, bool>> vals;
+    auto isFloatOp = [](const ir::Operand& op) {
+        return op.type == ir::Type::Float || op.type == ir::Type::FloatLiteral;
+    };
+    auto isScalar = [&](const ir::Operand& op) {
+        return globalInit.count(op.name) && globalInit[op.name].size() == 1 && op.type != ir::Type::IntPtr && op.type != ir::Type::FloatPtr;
+    };
+    auto getInt = [&](const ir::Operand& op, int32_t& v) {
+        if (op.type == ir::Type::IntLiteral) { v = std::stoi(op.name); return true; }
+        if (op.type != ir::Type::Int) return false;
+        if (isScalar(op)) { v = static_cast<int32_t>(globalInit[op.name][0]); return true; }
+        auto it = vals.find(op.name);
+        if (it == vals.end() || it->second.second) return false;
+        v = static_cast<int32_t>(it->second.first);
+        return true;
+    };
+    auto getFloat = [&](const ir::Operand& op, float& v) {
+        if (op.type == ir::Type::FloatLiteral) { v = std::stof(op.name); return true; }
+        if (op.type != ir::Type::Float) return false;
+        uint32_t w;
+        if (isScalar(op)) w = globalInit[op.name][0];
+        else if (vals.count(op.name) && vals[op.name].second) w = vals[op.name].first;
+        else return false;
+        std::memcpy(&v, &w, 4);
+        return true;
+    };
+    auto setWord = [&](const ir::Operand& op, uint32_t w, bool isFloat) {
+        if (isScalar(op)) globalInit[op.name][0] = w;
+        else vals[op.name] = {w, isFloat};
+    };
+    auto setInt = [&](const ir::Operand& op, int32_t v) { setWord(op, static_cast<uint32_t>(v), false); };
+    auto setFloat = [&](const ir::Operand& op, float v) {
+        uint32_t w;
+        std::memcpy(&w, &v, 4);
+        setWord(op, w, true);
+    };
+
+    for (const auto instPtr : init->InstVec) {
+        const auto& inst = *instPtr;
+        int32_t a, b;
+        float fa, fb;
+        switch (inst.op) {
+            case ir::Operator::def: case ir::Operator::mov:
+                if (!getInt(inst.op1, a)) return false;
+                setInt(inst.des, a);
+                break;
+            case ir::Operator::fdef: case ir::Operator::fmov:
+                if (!getFloat(inst.op1, fa)) return false;
+                setFloat(inst.des, fa);
+                break;
+            case ir::Operator::cvt_i2f:
+                if (!getInt(inst.op1, a)) return false;
+                setFloat(inst.des, static_cast<float>(a));
+                break;
+            case ir::Operator::cvt_f2i:
+                if (!getFloat(inst.op1, fa) || !(fa > INT_MIN - 1.0f && fa < INT_MAX + 1.0f)) return false;
+                setInt(inst.des, static_cast<int32_t>(fa));
+                break;
+            case ir::Operator::add: case ir::Operator::addi: case ir::Operator::sub: case ir::Operator::subi:
+            case ir::Operator::mul: case ir::Operator::div: case ir::Operator::mod: {
+                if (!getInt(inst.op1, a) || !getInt(inst.op2, b)) return false;
+                // wrap around like the machine does
+                uint32_t ua = a, ub = b, res = 0;
+                switch (inst.op) {
+                    case ir::Operator::add: case ir::Operator::addi: res = ua + ub; break;
+                    case ir::Operator::sub: case ir::Operator::subi: res = ua - ub; break;
+                    case ir::Operator::mul: res = ua * ub; break;
+                    default:
+                        if (b == 0 || (a == INT_MIN && b == -1)) return false;
+                        res = inst.op == ir::Operator::div ? a / b : a % b;
+                        break;
+                }
+                setInt(inst.des, static_cast<int32_t>(res));
+            } break;
+            case ir::Operator::fadd: case ir::Operator::fsub: case ir::Operator::fmul: case ir::Operator::fdiv: {
+                if (!getFloat(inst.op1, fa) || !getFloat(inst.op2, fb)) return false;
+                float res = inst.op == ir::Operator::fadd ? fa + fb : inst.op == ir::Operator::fsub ? fa - fb
+                          : inst.op == ir::Operator::fmul ? fa * fb : fa / fb;
+                setFloat(inst.des, res);
+            } break;
+            case ir::Operator::alloc:
+                // global arrays are in .data already
+                if (!isGlobalVar(inst.des)) return false;
+                break;
+            case ir::Operator::store: case ir::Operator::load: {
+                if (!globalInit.count(inst.op1.name) || !getInt(inst.op2, b)) return false;
+                auto& arr = globalInit[inst.op1.name];
+                if (b < 0 || b >= static_cast<int32_t>(arr.size())) return false;
+                bool isFloatArr = inst.op1.type == ir::Type::FloatPtr;
+                if (inst.op == ir::Operator::load) {
+                    if (isFloatArr != isFloatOp(inst.des)) return false;
+                    setWord(inst.des, arr[b], isFloatArr);
+                } else if (isFloatArr) {
+                    // an int stored into a float array is converted
+                    if (getInt(inst.des, a)) fa = static_cast<float>(a);
+                    else if (!getFloat(inst.des, fa)) return false;
+                    std::memcpy(&arr[b], &fa, 4);
+                } else {
+                    if (!getInt(inst.des, a)) return false;
+                    arr[b] = static_cast<uint32_t>(a);
+                }
+            } break;
+            case ir::Operator::_return:
+                return true;
+            case ir::Operator::__unuse__:
+                break;
+            default:
+                return false;
         }
-    }// first pass: collect all jump targets
+    }
+    return true;
+}
+
+namespace {
+
+using rv::rvREG;
+using rv::rvFREG;
+using rv::rvOPCODE;
+using rv::inst;
+
+const rvREG zero = rvREG::X0, ra = rvREG::X1, sp = rvREG::X2;
+const rvREG t0 = rvREG::X5, t1 = rvREG::X6, t2 = rvREG::X7, t3 = rvREG::X28;
+const rvFREG ft0 = rvFREG::F0, ft1 = rvFREG::F1, ft2 = rvFREG::F2, fa0 = rvFREG::F10;
+
+rvREG argReg(size_t i) {
+    return static_cast<rvREG>(static_cast<int>(rvREG::X10) + i);
+}
+
+bool fitsImm12(long long v) {
+    return v >= -2048 && v <= 2047;
+}
+
+// the bits of a float literal, or of an int literal converted to float
+uint32_t floatBits(const ir::Operand& op) {
+    float f = op.type == ir::Type::IntLiteral ? static_cast<float>(std::stoi(op.name)) : std::stof(op.name);
+    uint32_t w;
+    std::memcpy(&w, &f, 4);
+    return w;
+}
+
+} // namespace
+
+void backend::Generator::gen_func(const ir::Function& func) {
+    // put the scalar variables in registers, then give the others and the arrays their stack slots
+    curFunc = &func;
+    localSymbols.clear();
+    for (const auto& param : func.ParameterList) {
+        if (param.type == ir::Type::IntPtr || param.type == ir::Type::FloatPtr) localSymbols[param.name] = SymbolKind::pointerParam;
+    }
+    lastPc = -1;
+    for (size_t i = 0; i < func.InstVec.size(); i++) {
+        const auto& instr = *func.InstVec[i];
+        if (instr.op == ir::Operator::alloc && !isGlobalVar(instr.des)) localSymbols[instr.des.name] = SymbolKind::localArray;
+        if (instr.op != ir::Operator::__unuse__) lastPc = static_cast<int>(i);
+    }
+    constants = opt::int_constants(func, globalNames);
+    planReturnAddress(func);
+    regs = allocateRegisters(allocator, func, globalNames, !hasCall);
+    layoutFrame(func);
+    code.clear();
+    // prologue: allocate stack frame, save return address and the callee-saved registers in use at its bottom,
+    // a leaf function which keeps everything in caller-saved registers has no frame
+    if (frameSize) adjustSp(-frameSize);
+    if (saveRaAtEntry) emit(inst(rvOPCODE::SW, ra, sp, 0));
+    int saveOff = hasCall ? 4 : 0;
+    for (auto r : regs.usedCalleeSaved) {
+        emit(inst(rvOPCODE::SW, r, sp, saveOff));
+        saveOff += 4;
+    }
+    for (auto r : regs.usedCalleeSavedF) {
+        emit(inst(rvOPCODE::FSW, r, sp, saveOff));
+        saveOff += 4;
+    }
+    moveParams(func);
+    // first pass: collect all jump targets, and count the uses of the variables
     std::set<int> jumpTargets;
+    useCount.clear();
     for (size_t i = 0; i < func.InstVec.size(); i++) {
         const auto& instr = *func.InstVec[i];
         if (instr.op == ir::Operator::_goto) {
-            // check if des is a number (relative offset)
-            bool isNumber = true;
-            std::string desName = instr.des.name;
-            // handle negative numbers
-            size_t startPos = 0;
-            if (!desName.empty() && desName[0] == '-') {
-                startPos = 1;
-            }
-            for (size_t j = startPos; j < desName.length(); j++) {
-                if (!std::isdigit(desName[j])) {
-                    isNumber = false;
-                    break;
-                }
-            }
-            if (isNumber && !desName.empty()) {
-                int offset = std::stoi(desName);
-                int target = static_cast<int>(i) + offset;
-                if (target >= 0 && target < static_cast<int>(func.InstVec.size())) {
-                    jumpTargets.insert(target);
-                }
-            }
+            jumpTargets.insert(static_cast<int>(i) + std::stoi(instr.des.name));
         }
-    }    // generate instructions with labels
+        for (const auto& use : opt::uses_of(func.InstVec[i])) useCount[use.name]++;
+    }
+    // generate instructions with labels
     for (size_t i = 0; i < func.InstVec.size(); i++) {
         // insert label if this instruction is a jump target
         if (jumpTargets.find(static_cast<int>(i)) != jumpTargets.end()) {
-            fout << func.name << "_label_" << i << ":\n";
+            emit(inst(rvOPCODE::LABEL, func.name + "_label_" + std::to_string(i)));
+        }
+        // a condition only used by a branch is not computed, the branch compares
+        int gotoPc = fusedGoto(func, static_cast<int>(i), jumpTargets);
+        if (gotoPc >= 0) {
+            bool negate = false;
+            for (int j = i; j < gotoPc; j++) {
+                if (func.InstVec[j]->op == ir::Operator::_not) negate = !negate;
+            }
+            gen_branch(*func.InstVec[i], negate, gotoPc, func.name);
+            i = gotoPc;
+            continue;
         }
         gen_instr(*func.InstVec[i], static_cast<int>(i), func.name, &func);
     }
-    // epilogue: restore return address and release frame
-    fout << "  lw ra, " << frame - 4 << "(sp)\n";
-    fout << "  addi sp, sp, " << frame << "\n";
-    fout << "  jr ra\n";
+    // the epilogue which the last instruction falls into comes first, the other one follows if a _return jumps to it,
+    // a jump to the end of function lands on the one matching whether a call may have happened
+    int end = static_cast<int>(func.InstVec.size());
+    bool endsWithReturn = lastPc >= 0 && func.InstVec[lastPc]->op == ir::Operator::_return;
+    bool first = endsWithReturn ? calledBefore[lastPc] : calledBefore[end];
+    if (!endsWithReturn) epilogueUsed.insert(first);
+    if (jumpTargets.count(end)) epilogueUsed.insert(calledBefore[end]);
+    for (bool restoreRa : {first, !first}) {
+        if (!epilogueUsed.count(restoreRa)) continue;
+        if (jumpTargets.count(end) && calledBefore[end] == restoreRa) {
+            emit(inst(rvOPCODE::LABEL, func.name + "_label_" + std::to_string(end)));
+        }
+        emit(inst(rvOPCODE::LABEL, epilogueLabel(restoreRa)));
+        gen_epilogue(restoreRa);
+    }
+    assert(svmap.next_offset <= frameSize && "a stack slot is allocated after the frame layout");
+
+    peephole(code);
+    // the counts of the blocks, if the profile was recorded from this very function
+    std::map<std::string, uint64_t> counts;
+    const opt::FunctionCounts* fc = nullptr;
+    if (profile && profile->functions.count(func.name)) fc = &profile->functions.at(func.name);
+    if (fc && fc->counts.size() == func.InstVec.size()) {
+        counts[func.name] = fc->calls;
+        for (int pc : jumpTargets) {
+            if (pc < end) counts[func.name + "_label_" + std::to_string(pc)] = fc->counts[pc];
+        }
+    }
+    layoutBlocks(code, func.name, counts);
+    fout << func.name << ":\n";
+    for (const auto& ri : code) {
+        fout << (ri.op == rvOPCODE::LABEL ? "" : "  ") << ri.draw() << "\n";
+    }
 }
 
-void backend::Generator::gen_instr(const ir::Instruction& instr, int pc, const std::string& funcName, const ir::Function* func) {
-    using namespace ir;
-    switch (instr.op) {        case Operator::def: {
-            // if rhs is literal, use li; otherwise load from its slot
-            if (instr.op1.type == ir::Type::IntLiteral) {
-                fout << "  li t0, " << instr.op1.name << "\n";
+int backend::Generator::fusedGoto(const ir::Function& func, int pc, const std::set<int>& jumpTargets) const {
+    using ir::Operator;
+    switch (func.InstVec[pc]->op) {
+        case Operator::lss: case Operator::leq: case Operator::gtr: case Operator::geq:
+        case Operator::eq: case Operator::neq: case Operator::_not:
+            break;
+        default:
+            return -1;
+    }
+    // the condition may go through _nots: t1 = a < b, t2 = !t1, goto t2
+    auto cond = func.InstVec[pc]->des;
+    for (size_t i = pc + 1; i < func.InstVec.size(); i++) {
+        const auto& next = *func.InstVec[i];
+        auto uses = useCount.find(cond.name);
+        if (jumpTargets.count(static_cast<int>(i)) || isGlobalVar(cond) || uses == useCount.end() || uses->second != 1) return -1;
+        if (next.op == Operator::__unuse__) continue;
+        if (next.op == Operator::_goto && next.op1.name == cond.name) return static_cast<int>(i);
+        if (next.op != Operator::_not || next.op1.name != cond.name) return -1;
+        cond = next.des;
+    }
+    return -1;
+}
+
+void backend::Generator::gen_branch(const ir::Instruction& cond, bool negate, int gotoPc, const std::string& funcName) {
+    using ir::Operator;
+    const auto& jump = *curFunc->InstVec[gotoPc];
+    std::string target = funcName + "_label_" + std::to_string(gotoPc + std::stoi(jump.des.name));
+    if (cond.op == Operator::_not) {
+        // branch on the operand of the first _not, negate counts it already
+        auto rs = getRs1(cond.op1);
+        emit(inst(negate ? rvOPCODE::BEQZ : rvOPCODE::BNEZ, rs, target));
+        return;
+    }
+    auto rs1 = getRs1(cond.op1);
+    auto rs2 = getRs2(cond.op2);
+    // a < b is blt a, b, a <= b is bge b, a, and the negations swap blt and bge, beq and bne
+    switch (cond.op) {
+        case Operator::lss: emit(inst(negate ? rvOPCODE::BGE : rvOPCODE::BLT, rs1, rs2, target)); break;
+        case Operator::leq: emit(inst(negate ? rvOPCODE::BLT : rvOPCODE::BGE, rs2, rs1, target)); break;
+        case Operator::gtr: emit(inst(negate ? rvOPCODE::BGE : rvOPCODE::BLT, rs2, rs1, target)); break;
+        case Operator::geq: emit(inst(negate ? rvOPCODE::BLT : rvOPCODE::BGE, rs1, rs2, target)); break;
+        case Operator::eq:  emit(inst(negate ? rvOPCODE::BNE : rvOPCODE::BEQ, rs1, rs2, target)); break;
+        default:            emit(inst(negate ? rvOPCODE::BEQ : rvOPCODE::BNE, rs1, rs2, target)); break;
+    }
+}
+
+void backend::Generator::moveParams(const ir::Function& func) {
+    // First 8 params come from argument registers a0-a7, the ones going to a stack slot or a float register are
+    // stored first; a leaf function may keep a param in the argument register of another one, so a register
+    // is only written once no move reads it any more, and a cycle of moves goes through t0
+    std::vector<std::pair<rvREG, rvREG>> moves;    // (dst, src)
+    for (size_t i = 0; i < func.ParameterList.size() && i < 8; i++) {
+        const auto& param = func.ParameterList[i];
+        auto it = regs.reg.find(param.name);
+        if (it == regs.reg.end()) storeOperand(param, argReg(i));
+        else if (it->second != argReg(i)) moves.push_back({it->second, argReg(i)});
+    }
+    auto isRead = [&](rvREG r) {
+        return std::any_of(moves.begin(), moves.end(), [&](const std::pair<rvREG, rvREG>& m) { return m.second == r; });
+    };
+    while (!moves.empty()) {
+        auto ready = std::find_if(moves.begin(), moves.end(), [&](const std::pair<rvREG, rvREG>& m) { return !isRead(m.first); });
+        if (ready == moves.end()) {
+            emit(inst(rvOPCODE::MOV, t0, moves.front().second));
+            moves.front().second = t0;
+            continue;
+        }
+        emit(inst(rvOPCODE::MOV, ready->first, ready->second));
+        moves.erase(ready);
+    }
+    // Params 8+ are on the caller's stack: arg[8] is at caller_sp + 0, arg[9] at caller_sp + 4, etc.
+    for (size_t i = 8; i < func.ParameterList.size(); i++) {
+        rvREG base;
+        int off;
+        stackSlot(frameSize + (i - 8) * 4, t1, base, off);
+        emit(inst(rvOPCODE::LW, t0, base, off));
+        storeOperand(func.ParameterList[i], t0);
+    }
+}
+
+void backend::Generator::emit(const rv::rv_inst& ri) {
+    code.push_back(ri);
+}
+
+void backend::Generator::layoutFrame(const ir::Function& func) {
+    // ra and the callee-saved registers are at the bottom, so the prologue and epilogue address them directly
+    svmap = stackVarMap();
+    svmap.next_offset = 4 * static_cast<int>((hasCall ? 1 : 0) + regs.usedCalleeSaved.size() + regs.usedCalleeSavedF.size());
+    auto addSlot = [&](const ir::Operand& op) {
+        if (!opt::is_var(op) || isGlobalVar(op) || regs.reg.count(op.name) || regs.freg.count(op.name)) return;
+        svmap.find_operand(op);
+    };
+    for (const auto inst : func.InstVec) {
+        if (inst->op == ir::Operator::alloc && isLocalArray(inst->des)) {
+            svmap.add_operand(inst->des, std::stoi(inst->op1.name) * 4);
+        }
+    }
+    for (const auto& param : func.ParameterList) addSlot(param);
+    for (const auto inst : func.InstVec) {
+        for (const auto& use : opt::uses_of(inst)) addSlot(use);
+        if (auto def = opt::def_of(inst)) addSlot(*def);
+    }
+    frameSize = (svmap.next_offset + 15) / 16 * 16;
+}
+
+void backend::Generator::adjustSp(int delta) {
+    if (fitsImm12(delta)) {
+        emit(inst(rvOPCODE::ADDI, sp, sp, delta));
+    } else {
+        loadImm(t0, delta);
+        emit(inst(rvOPCODE::ADD, sp, sp, t0));
+    }
+}
+
+void backend::Generator::loadImm(rv::rvREG rd, int32_t value) {
+    if (fitsImm12(value)) {
+        emit(inst(rvOPCODE::LI, rd, value));
+        return;
+    }
+    // addi sign-extends the low 12 bits, lui makes up for it
+    int32_t lo = static_cast<int32_t>((static_cast<uint32_t>(value) & 0xfff) ^ 0x800) - 0x800;
+    int32_t hi = static_cast<int32_t>(((static_cast<uint32_t>(value) - static_cast<uint32_t>(lo)) >> 12) & 0xfffff);
+    emit(inst(rvOPCODE::LUI, rd, hi));
+    if (lo != 0) emit(inst(rvOPCODE::ADDI, rd, rd, lo));
+}
+
+namespace {
+
+// |d| as an unsigned value, INT_MIN included
+uint32_t magnitude(int32_t d) {
+    return d < 0 ? 0u - static_cast<uint32_t>(d) : static_cast<uint32_t>(d);
+}
+
+bool isPowerOf2(uint32_t v) {
+    return v && !(v & (v - 1));
+}
+
+int log2Exact(uint32_t v) {
+    int k = 0;
+    while (v >>= 1) k++;
+    return k;
+}
+
+// the multiplier m and shift s of the signed division by d, |d| >= 2 and not a power of 2,
+// such that n / d = (mulh(n, m) [+- n]) >> s, plus one if that is negative (Hacker's Delight 10-1)
+void signedMagic(int32_t d, int32_t& m, int& s) {
+    const uint32_t two31 = 0x80000000u;
+    uint32_t ad = magnitude(d);
+    uint32_t t = two31 + (static_cast<uint32_t>(d) >> 31);
+    uint32_t anc = t - 1 - t % ad;
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+    uint32_t delta;
+    int p = 31;
+    do {
+        p++;
+        q1 *= 2; r1 *= 2;
+        if (r1 >= anc) { q1++; r1 -= anc; }
+        q2 *= 2; r2 *= 2;
+        if (r2 >= ad) { q2++; r2 -= ad; }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    uint32_t mag = q2 + 1;
+    m = static_cast<int32_t>(d < 0 ? 0u - mag : mag);
+    s = p - 32;
+}
+
+} // namespace
+
+void backend::Generator::mulConst(rv::rvREG rd, rv::rvREG rs, int32_t c) {
+    uint32_t a = magnitude(c);
+    if (a == 1) {
+        emit(c < 0 ? inst(rvOPCODE::SUB, rd, zero, rs) : inst(rvOPCODE::MOV, rd, rs));
+        return;
+    }
+    // 2^k, 2^k + 1 and 2^k - 1 take a shift and at most one add or sub, a negative multiplier one more sub
+    if (isPowerOf2(a)) {
+        emit(inst(rvOPCODE::SLLI, rd, rs, log2Exact(a)));
+    } else if (isPowerOf2(a - 1)) {
+        emit(inst(rvOPCODE::SLLI, t1, rs, log2Exact(a - 1)));
+        emit(inst(rvOPCODE::ADD, rd, t1, rs));
+    } else if (a != 0xffffffffu && isPowerOf2(a + 1)) {
+        emit(inst(rvOPCODE::SLLI, t1, rs, log2Exact(a + 1)));
+        emit(inst(rvOPCODE::SUB, rd, t1, rs));
+    } else {
+        loadImm(t1, c);
+        emit(inst(rvOPCODE::MUL, rd, rs, t1));
+        return;
+    }
+    if (c < 0) emit(inst(rvOPCODE::SUB, rd, zero, rd));
+}
+
+void backend::Generator::divConst(rv::rvREG rd, rv::rvREG rs, int32_t d) {
+    uint32_t a = magnitude(d);
+    if (a == 1) {
+        emit(d < 0 ? inst(rvOPCODE::SUB, rd, zero, rs) : inst(rvOPCODE::MOV, rd, rs));
+        return;
+    }
+    if (isPowerOf2(a)) {
+        // the shift rounds towards -inf, a negative dividend is biased by 2^k - 1 to round towards 0
+        int k = log2Exact(a);
+        if (k == 1) {
+            emit(inst(rvOPCODE::SRLI, t1, rs, 31));
+        } else {
+            emit(inst(rvOPCODE::SRAI, t1, rs, 31));
+            emit(inst(rvOPCODE::SRLI, t1, t1, 32 - k));
+        }
+        emit(inst(rvOPCODE::ADD, t1, t1, rs));
+        emit(inst(rvOPCODE::SRAI, rd, t1, k));
+        if (d < 0) emit(inst(rvOPCODE::SUB, rd, zero, rd));
+        return;
+    }
+    int32_t m;
+    int s;
+    signedMagic(d, m, s);
+    loadImm(t1, m);
+    emit(inst(rvOPCODE::MULH, t1, rs, t1));
+    if (d > 0 && m < 0) emit(inst(rvOPCODE::ADD, t1, t1, rs));
+    if (d < 0 && m > 0) emit(inst(rvOPCODE::SUB, t1, t1, rs));
+    if (s) emit(inst(rvOPCODE::SRAI, t1, t1, s));
+    emit(inst(rvOPCODE::SRLI, t3, t1, 31));
+    emit(inst(rvOPCODE::ADD, rd, t1, t3));
+}
+
+void backend::Generator::modConst(rv::rvREG rd, rv::rvREG rs, int32_t d) {
+    uint32_t a = magnitude(d);
+    if (a == 1) {
+        emit(inst(rvOPCODE::MOV, rd, zero));
+        return;
+    }
+    // the remainder takes the sign of the dividend, so n % d = n % |d| = n - (n / |d|) * |d|
+    int k = isPowerOf2(a) ? log2Exact(a) : 0;
+    if (k && k <= 11) {
+        // the biased dividend masked down to a multiple of 2^k
+        if (k == 1) {
+            emit(inst(rvOPCODE::SRLI, t1, rs, 31));
+        } else {
+            emit(inst(rvOPCODE::SRAI, t1, rs, 31));
+            emit(inst(rvOPCODE::SRLI, t1, t1, 32 - k));
+        }
+        emit(inst(rvOPCODE::ADD, t1, t1, rs));
+        emit(inst(rvOPCODE::ANDI, t1, t1, -(1 << k)));
+        emit(inst(rvOPCODE::SUB, rd, rs, t1));
+        return;
+    }
+    if (k) {
+        divConst(t3, rs, static_cast<int32_t>(a));
+        emit(inst(rvOPCODE::SLLI, t3, t3, k));
+    } else {
+        divConst(t3, rs, d);
+        mulConst(t3, t3, d);
+    }
+    emit(inst(rvOPCODE::SUB, rd, rs, t3));
+}
+
+void backend::Generator::stackSlot(int slot, rv::rvREG tmp, rv::rvREG& base, int& off) {
+    if (fitsImm12(slot)) {
+        base = sp;
+        off = slot;
+        return;
+    }
+    loadImm(tmp, slot);
+    emit(inst(rvOPCODE::ADD, tmp, sp, tmp));
+    base = tmp;
+    off = 0;
+}
+
+void backend::Generator::gen_epilogue(bool restoreRa) {
+    int saveOff = hasCall ? 4 : 0;
+    for (auto r : regs.usedCalleeSaved) {
+        emit(inst(rvOPCODE::LW, r, sp, saveOff));
+        saveOff += 4;
+    }
+    for (auto r : regs.usedCalleeSavedF) {
+        emit(inst(rvOPCODE::FLW, r, sp, saveOff));
+        saveOff += 4;
+    }
+    if (restoreRa) emit(inst(rvOPCODE::LW, ra, sp, 0));
+    if (frameSize) adjustSp(frameSize);
+    emit(inst(rvOPCODE::JR, ra));
+}
+
+std::string backend::Generator::epilogueLabel(bool restoreRa) const {
+    return curFunc->name + (restoreRa ? "_epilogue_ra" : "_epilogue");
+}
+
+bool backend::Generator::isCall(const ir::Instruction& instr) const {
+    return instr.op == ir::Operator::call && !(staticGlobalInit && instr.op1.name == "global");
+}
+
+void backend::Generator::planReturnAddress(const ir::Function& func) {
+    int n = static_cast<int>(func.InstVec.size());
+    hasCall = false;
+    for (auto instr : func.InstVec) hasCall = hasCall || isCall(*instr);
+    saveRaAtEntry = false;
+    raSaves.clear();
+    epilogueUsed.clear();
+    calledBefore.assign(n + 1, false);
+    if (!hasCall) return;
+
+    // whether a call may or must have happened before each reachable pc, n is the end of function
+    std::vector<bool> reached(n + 1, false), may(n + 1, false), must(n + 1, false);
+    reached[0] = true;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int pc = 0; pc < n; pc++) {
+            const auto& instr = *func.InstVec[pc];
+            if (!reached[pc] || instr.op == ir::Operator::_return) continue;
+            bool outMay = may[pc] || isCall(instr), outMust = must[pc] || isCall(instr);
+            std::vector<int> succs;
+            if (instr.op == ir::Operator::_goto) {
+                succs.push_back(pc + std::stoi(instr.des.name));
+                if (instr.op1.name != "null") succs.push_back(pc + 1);
             } else {
-                loadOperand(instr.op1, "t0");
+                succs.push_back(pc + 1);
+            }
+            for (int next : succs) {
+                bool m = reached[next] ? may[next] || outMay : outMay;
+                bool u = reached[next] ? must[next] && outMust : outMust;
+                if (reached[next] && m == may[next] && u == must[next]) continue;
+                reached[next] = true;
+                may[next] = m;
+                must[next] = u;
+                changed = true;
             }
-            storeOperand(instr.des, "t0");
-            break;
         }
-        case Operator::mov: {
-            loadOperand(instr.op1, "t0");
-            storeOperand(instr.des, "t0");
-            break;
-        }        case Operator::add: {
-            loadOperand(instr.op1, "t0");
-            loadOperand(instr.op2, "t1");
-            fout << "  add t2, t0, t1\n";
-            storeOperand(instr.des, "t2");
-            break;
+    }
+
+    // the body [target, pc] of a backward _goto is a loop
+    auto inLoop = [&](int pc) {
+        for (int i = pc; i < n; i++) {
+            const auto& instr = *func.InstVec[i];
+            if (instr.op == ir::Operator::_goto && i + std::stoi(instr.des.name) <= pc) return true;
         }
-        case Operator::addi: {
-            loadOperand(instr.op1, "t0");
-            int imm = std::stoi(instr.op2.name);
-            fout << "  addi t1, t0, " << imm << "\n";
-            storeOperand(instr.des, "t1");
+        return false;
+    };
+    for (int pc = 0; pc <= n; pc++) {
+        if (!reached[pc]) continue;
+        bool isReturn = pc == n || func.InstVec[pc]->op == ir::Operator::_return;
+        if (pc < n && isCall(*func.InstVec[pc]) && !must[pc]) {
+            // ra already holds the return address into this function after a call, so it is saved on no path before
+            if (may[pc] || inLoop(pc)) saveRaAtEntry = true;
+            raSaves.insert(pc);
+        }
+        if (isReturn && may[pc] != must[pc]) saveRaAtEntry = true;
+    }
+    if (saveRaAtEntry) raSaves.clear();
+    for (int pc = 0; pc <= n; pc++) calledBefore[pc] = may[pc];
+}
+
+void backend::Generator::gen_instr(const ir::Instruction& instr, int pc, const std::string& funcName, const ir::Function* func) {
+    using namespace ir;
+    // a constant out of a register is materialized at its uses, the def/mov or arithmetic computing it is dropped
+    auto def = opt::def_of(&instr);
+    if (def && constants.count(def->name) && !regs.reg.count(def->name)) return;
+    switch (instr.op) {
+        case Operator::def: case Operator::mov: {
+            auto rd = getRd(instr.des);
+            loadOperand(instr.op1, rd);
+            storeOperand(instr.des, rd);
             break;
         }
-        case Operator::sub: {
-            loadOperand(instr.op1, "t0");
-            loadOperand(instr.op2, "t1");
-            fout << "  sub t2, t0, t1\n";
-            storeOperand(instr.des, "t2");
+        case Operator::add: case Operator::addi: case Operator::sub: case Operator::subi: {
+            bool isSub = instr.op == Operator::sub || instr.op == Operator::subi;
+            const Operand* lhs = &instr.op1;
+            const Operand* rhs = &instr.op2;
+            // the constant of an add goes second, a constant which fits in 12 bits is the immediate of an addi
+            int c;
+            if (!isSub && isConstant(*lhs, c) && !isConstant(*rhs, c)) std::swap(lhs, rhs);
+            if (isConstant(*rhs, c)) {
+                long long imm = isSub ? -static_cast<long long>(c) : c;
+                auto rs1 = getRs1(*lhs);
+                auto rd = getRd(instr.des);
+                if (fitsImm12(imm)) {
+                    emit(inst(rvOPCODE::ADDI, rd, rs1, static_cast<int32_t>(imm)));
+                } else {
+                    loadImm(t1, static_cast<int32_t>(imm));
+                    emit(inst(rvOPCODE::ADD, rd, rs1, t1));
+                }
+                storeOperand(instr.des, rd);
+                break;
+            }
+            auto rs1 = getRs1(*lhs);
+            auto rs2 = getRs2(*rhs);
+            auto rd = getRd(instr.des);
+            emit(inst(isSub ? rvOPCODE::SUB : rvOPCODE::ADD, rd, rs1, rs2));
+            storeOperand(instr.des, rd);
             break;
         }
-        case Operator::subi: {
-            loadOperand(instr.op1, "t0");
-            int imm = std::stoi(instr.op2.name);
-            fout << "  addi t1, t0, -" << imm << "\n";
-            storeOperand(instr.des, "t1");
+        case Operator::mul: case Operator::div: case Operator::mod: {
+            // a constant multiplier or divisor is strength reduced, the multiplier may come first
+            const Operand* lhs = &instr.op1;
+            const Operand* rhs = &instr.op2;
+            int c;
+            if (instr.op == Operator::mul && isConstant(*lhs, c) && !isConstant(*rhs, c)) std::swap(lhs, rhs);
+            if (isConstant(*rhs, c) && c != 0) {
+                auto rs1 = getRs1(*lhs);
+                auto rd = getRd(instr.des);
+                if (instr.op == Operator::mul) mulConst(rd, rs1, c);
+                else if (instr.op == Operator::div) divConst(rd, rs1, c);
+                else modConst(rd, rs1, c);
+                storeOperand(instr.des, rd);
+                break;
+            }
+            auto rs1 = getRs1(instr.op1);
+            auto rs2 = getRs2(instr.op2);
+            auto rd = getRd(instr.des);
+            auto op = instr.op == Operator::mul ? rvOPCODE::MUL : instr.op == Operator::div ? rvOPCODE::DIV : rvOPCODE::REM;
+            emit(inst(op, rd, rs1, rs2));
+            storeOperand(instr.des, rd);
             break;
-        }        case Operator::load: {
+        }
+        case Operator::load: {
             // load dest, array, index
-            if (isGlobalVar(instr.op1)) {
-                // loading from global array
-                if (instr.op2.type == ir::Type::IntLiteral) {
-                    int idx = std::stoi(instr.op2.name) * 4;
-                    fout << "  la t2, " << instr.op1.name << "\n";
-                    fout << "  lw t0, " << idx << "(t2)\n";
-                } else {
-                    loadOperand(instr.op2, "t1");
-                    fout << "  slli t1, t1, 2\n";  // multiply by 4
-                    fout << "  la t2, " << instr.op1.name << "\n";
-                    fout << "  add t2, t2, t1\n";
-                    fout << "  lw t0, 0(t2)\n";
-                }
+            rvREG base;
+            int off;
+            elemAddr(instr.op1, instr.op2, base, off);
+            if (instr.des.type == Type::Float) {
+                auto fd = fgetRd(instr.des);
+                emit(inst(rvOPCODE::FLW, fd, base, off));
+                fstoreOperand(instr.des, fd);
             } else {
-                // check if this is a pointer parameter (not a local array)
-                bool isLocalArray = false;
-                if (func) {
-                    for (const auto& instPtr : func->InstVec) {
-                        if (instPtr->op == ir::Operator::alloc && instPtr->des.name == instr.op1.name) {
-                            isLocalArray = true;
-                            break;
-                        }
-                    }
-                }
-                
-                if (!isLocalArray && instr.op1.name.find("_scope_") != std::string::npos) {
-                    // This is likely a pointer parameter
-                    loadOperand(instr.op1, "t2");  // load pointer address
-                    if (instr.op2.type == ir::Type::IntLiteral) {
-                        int idx = std::stoi(instr.op2.name) * 4;
-                        fout << "  lw t0, " << idx << "(t2)\n";
-                    } else {
-                        loadOperand(instr.op2, "t1");
-                        fout << "  slli t1, t1, 2\n";
-                        fout << "  add t2, t2, t1\n";
-                        fout << "  lw t0, 0(t2)\n";
-                    }                } else {
-                    // loading from local array
-                    int arrayOff = svmap.find_operand(instr.op1);
-                    if (instr.op2.type == ir::Type::IntLiteral) {
-                        int idx = std::stoi(instr.op2.name);
-                        fout << "  li t1, " << idx << "\n";
-                        fout << "  slli t1, t1, 2\n";
-                        fout << "  addi t2, sp, " << arrayOff << "\n";
-                        fout << "  add t2, t2, t1\n";
-                        fout << "  lw t0, 0(t2)\n";
-                    } else {
-                        loadOperand(instr.op2, "t1");
-                        fout << "  slli t1, t1, 2\n";
-                        fout << "  addi t2, sp, " << arrayOff << "\n";
-                        fout << "  add t2, t2, t1\n";
-                        fout << "  lw t0, 0(t2)\n";
-                    }
-                }
+                auto rd = getRd(instr.des);
+                emit(inst(rvOPCODE::LW, rd, base, off));
+                storeOperand(instr.des, rd);
             }
-            storeOperand(instr.des, "t0");
             break;
-        }        case Operator::store: {
-            // store value, array, index
-            loadOperand(instr.des, "t0");  // value to store
-            if (isGlobalVar(instr.op1)) {
-                // storing to global array
-                if (instr.op2.type == ir::Type::IntLiteral) {
-                    int idx = std::stoi(instr.op2.name) * 4;
-                    fout << "  la t2, " << instr.op1.name << "\n";
-                    fout << "  sw t0, " << idx << "(t2)\n";
-                } else {
-                    loadOperand(instr.op2, "t1");
-                    fout << "  slli t1, t1, 2\n";
-                    fout << "  la t2, " << instr.op1.name << "\n";
-                    fout << "  add t2, t2, t1\n";
-                    fout << "  sw t0, 0(t2)\n";
-                }
+        }
+        case Operator::store: {
+            // store value, array, index, the value is fetched before the address is computed in t1/t3
+            bool isFloat = instr.op1.type == Type::FloatPtr;
+            rvREG rs = zero;
+            rvFREG fs = ft0;
+            if (isFloat && instr.des.type == Type::Int) {
+                // an int stored into a float array is converted
+                auto ri = getRs(instr.des, t0);
+                emit(inst(rvOPCODE::FCVT_S_W, ft0, ri));
+            } else if (isFloat) {
+                fs = fgetRs(instr.des, ft0);
             } else {
-                // check if this is a pointer parameter (not a local array)
-                bool isLocalArray = false;
-                if (func) {
-                    for (const auto& instPtr : func->InstVec) {
-                        if (instPtr->op == ir::Operator::alloc && instPtr->des.name == instr.op1.name) {
-                            isLocalArray = true;
-                            break;
-                        }
-                    }
-                }
-                
-                if (!isLocalArray && instr.op1.name.find("_scope_") != std::string::npos) {
-                    // This is likely a pointer parameter
-                    loadOperand(instr.op1, "t2");  // load pointer address
-                    if (instr.op2.type == ir::Type::IntLiteral) {
-                        int idx = std::stoi(instr.op2.name) * 4;
-                        fout << "  sw t0, " << idx << "(t2)\n";
-                    } else {
-                        loadOperand(instr.op2, "t1");
-                        fout << "  slli t1, t1, 2\n";
-                        fout << "  add t2, t2, t1\n";
-                        fout << "  sw t0, 0(t2)\n";
-                    }                } else {
-                    // storing to local array
-                    int arrayOff = svmap.find_operand(instr.op1);
-                    if (instr.op2.type == ir::Type::IntLiteral) {
-                        int idx = std::stoi(instr.op2.name);
-                        fout << "  li t1, " << idx << "\n";
-                        fout << "  slli t1, t1, 2\n";
-                        fout << "  addi t2, sp, " << arrayOff << "\n";
-                        fout << "  add t2, t2, t1\n";
-                        fout << "  sw t0, 0(t2)\n";
-                    } else {
-                        loadOperand(instr.op2, "t1");
-                        fout << "  slli t1, t1, 2\n";
-                        fout << "  addi t2, sp, " << arrayOff << "\n";
-                        fout << "  add t2, t2, t1\n";
-                        fout << "  sw t0, 0(t2)\n";
-                    }
-                }
+                rs = getRs(instr.des, t0);
+            }
+            rvREG base;
+            int off;
+            elemAddr(instr.op1, instr.op2, base, off);
+            if (isFloat) {
+                emit(inst(rvOPCODE::FSW, fs, base, off));
+            } else {
+                emit(inst(rvOPCODE::SW, rs, base, off));
             }
-            break;
-        }        case Operator::_return: {
-            if (instr.op1.name != "null") {
-                loadOperand(instr.op1, "a0");
-            }            // Jump to function epilogue - use fixed frame size
-            fout << "  lw ra, 2040(sp)\n";  // frame - 4 = 2044 - 4 = 2040
-            fout << "  addi sp, sp, 2044\n";  // 恢复到原来的栈指针
-            fout << "  jr ra\n";
             break;
         }
-        case ir::Operator::fdef: {
-            int offd = svmap.find_operand(instr.des);
-            if (instr.op1.type == ir::Type::FloatLiteral) {
-                fout << "  li t0, " << instr.op1.name << "\n";
-                fout << "  fmv.w.x ft0, t0\n";
-            } else {
-                int srcOff = svmap.find_operand(instr.op1);
-                fout << "  flw ft0, " << srcOff << "(sp)\n";
+        case Operator::_return: {
+            if (instr.op1.name != "null") {
+                loadOperand(instr.op1, argReg(0));
             }
-            fout << "  fsw ft0, " << offd << "(sp)\n";
+            // the epilogue follows the last instruction, see gen_func
+            bool restoreRa = calledBefore[pc];
+            epilogueUsed.insert(restoreRa);
+            if (pc != lastPc) emit(inst(rvOPCODE::J, epilogueLabel(restoreRa)));
             break;
         }
-        case ir::Operator::fmov: {
-            int off1 = svmap.find_operand(instr.op1);
-            int offd = svmap.find_operand(instr.des);
-            fout << "  flw ft0, " << off1 << "(sp)\n";
-            fout << "  fsw ft0, " << offd << "(sp)\n";
+        case Operator::fdef: case Operator::fmov: {
+            auto fd = fgetRd(instr.des);
+            floadOperand(instr.op1, fd);
+            fstoreOperand(instr.des, fd);
             break;
         }
-        case ir::Operator::fadd: case ir::Operator::fsub: case ir::Operator::fmul: case ir::Operator::fdiv: {
-            int off1 = svmap.find_operand(instr.op1);
-            int off2 = svmap.find_operand(instr.op2);
-            int offd = svmap.find_operand(instr.des);
-            fout << "  flw ft0, " << off1 << "(sp)\n";
-            fout << "  flw ft1, " << off2 << "(sp)\n";
-            std::string op = (instr.op == ir::Operator::fadd ? "fadd.s" : instr.op == ir::Operator::fsub ? "fsub.s" : instr.op == ir::Operator::fmul ? "fmul.s" : "fdiv.s");
-            fout << "  " << op << " ft2, ft0, ft1\n";
-            fout << "  fsw ft2, " << offd << "(sp)\n";
+        case Operator::fadd: case Operator::fsub: case Operator::fmul: case Operator::fdiv: {
+            auto fs1 = fgetRs1(instr.op1);
+            auto fs2 = fgetRs2(instr.op2);
+            auto fd = fgetRd(instr.des);
+            auto op = instr.op == Operator::fadd ? rvOPCODE::FADD_S : instr.op == Operator::fsub ? rvOPCODE::FSUB_S
+                    : instr.op == Operator::fmul ? rvOPCODE::FMUL_S : rvOPCODE::FDIV_S;
+            emit(inst(op, fd, fs1, fs2));
+            fstoreOperand(instr.des, fd);
             break;
-        }        case ir::Operator::mul: case ir::Operator::div: case ir::Operator::mod: {
-            loadOperand(instr.op1, "t0");
-            loadOperand(instr.op2, "t1");
-            std::string op = (instr.op == ir::Operator::mul ? "mul" : instr.op == ir::Operator::div ? "div" : "rem");
-            fout << "  " << op << " t2, t0, t1\n";
-            storeOperand(instr.des, "t2");
+        }
+        case Operator::lss: case Operator::leq: case Operator::gtr: case Operator::geq: {
+            auto op = instr.op;
+            const Operand* lhs = &instr.op1;
+            const Operand* rhs = &instr.op2;
+            // the constant goes second: c < b is b > c
+            int c;
+            if (isConstant(*lhs, c) && !isConstant(*rhs, c)) {
+                std::swap(lhs, rhs);
+                op = op == Operator::lss ? Operator::gtr : op == Operator::gtr ? Operator::lss
+                   : op == Operator::leq ? Operator::geq : Operator::leq;
+            }
+            if (isConstant(*rhs, c)) {
+                // a <= c is a < c + 1, a > c is !(a < c + 1), a >= c is !(a < c)
+                long long imm = c;
+                if (op == Operator::leq || op == Operator::gtr) imm++;
+                if (fitsImm12(imm)) {
+                    auto rs1 = getRs1(*lhs);
+                    auto rd = getRd(instr.des);
+                    emit(inst(rvOPCODE::SLTI, rd, rs1, static_cast<int32_t>(imm)));
+                    if (op == Operator::gtr || op == Operator::geq) emit(inst(rvOPCODE::XORI, rd, rd, 1));
+                    storeOperand(instr.des, rd);
+                    break;
+                }
+            }
+            auto rs1 = getRs1(*lhs);
+            auto rs2 = getRs2(*rhs);
+            auto rd = getRd(instr.des);
+            if (op == Operator::lss) {
+                emit(inst(rvOPCODE::SLT, rd, rs1, rs2));
+            } else if (op == Operator::gtr) {
+                // a > b  equivalent to  b < a
+                emit(inst(rvOPCODE::SLT, rd, rs2, rs1));
+            } else if (op == Operator::leq) {
+                // a <= b  equivalent to  !(b < a)
+                emit(inst(rvOPCODE::SLT, rd, rs2, rs1));
+                emit(inst(rvOPCODE::XORI, rd, rd, 1));
+            } else {
+                // a >= b  equivalent to  !(a < b)
+                emit(inst(rvOPCODE::SLT, rd, rs1, rs2));
+                emit(inst(rvOPCODE::XORI, rd, rd, 1));
+            }
+            storeOperand(instr.des, rd);
             break;
-        }        case ir::Operator::lss: case ir::Operator::flss: case ir::Operator::leq: case ir::Operator::fleq:
-        case ir::Operator::gtr: case ir::Operator::fgtr: case ir::Operator::geq: case ir::Operator::fgeq: {
-            loadOperand(instr.op1, "t0");
-            loadOperand(instr.op2, "t1");
-            if (instr.op == ir::Operator::lss || instr.op == ir::Operator::flss) {
-                // t0 < t1
-                fout << "  slt t2, t0, t1\n";
-            } else if (instr.op == ir::Operator::gtr || instr.op == ir::Operator::fgtr) {
-                // t0 > t1  equivalent to  t1 < t0
-                fout << "  slt t2, t1, t0\n";
-            } else if (instr.op == ir::Operator::leq || instr.op == ir::Operator::fleq) {
-                // t0 <= t1  equivalent to  !(t0 > t1)  equivalent to  !(t1 < t0)
-                fout << "  slt t2, t1, t0\n";
-                fout << "  seqz t2, t2\n";
-            } else if (instr.op == ir::Operator::geq || instr.op == ir::Operator::fgeq) {
-                // t0 >= t1  equivalent to  !(t0 < t1)
-                fout << "  slt t2, t0, t1\n";
-                fout << "  seqz t2, t2\n";
+        }
+        case Operator::flss: case Operator::fleq: case Operator::fgtr: case Operator::fgeq:
+        case Operator::feq: case Operator::fneq: {
+            auto fs1 = fgetRs1(instr.op1);
+            auto fs2 = fgetRs2(instr.op2);
+            auto rd = getRd(instr.des);
+            switch (instr.op) {
+                case Operator::flss: emit(inst(rvOPCODE::FLT_S, rd, fs1, fs2)); break;
+                case Operator::fleq: emit(inst(rvOPCODE::FLE_S, rd, fs1, fs2)); break;
+                case Operator::fgtr: emit(inst(rvOPCODE::FLT_S, rd, fs2, fs1)); break;
+                case Operator::fgeq: emit(inst(rvOPCODE::FLE_S, rd, fs2, fs1)); break;
+                case Operator::feq:  emit(inst(rvOPCODE::FEQ_S, rd, fs1, fs2)); break;
+                default:
+                    emit(inst(rvOPCODE::FEQ_S, rd, fs1, fs2));
+                    emit(inst(rvOPCODE::XORI, rd, rd, 1));
+                    break;
             }
-            storeOperand(instr.des, "t2");
+            storeOperand(instr.des, rd);
             break;
         }
-        case ir::Operator::eq: case ir::Operator::feq: case ir::Operator::neq: case ir::Operator::fneq: {
-            loadOperand(instr.op1, "t0");
-            loadOperand(instr.op2, "t1");
-            fout << "  xor t2, t0, t1\n";
-            if (instr.op == ir::Operator::eq || instr.op == ir::Operator::feq) {
-                fout << "  sltiu t2, t2, 1\n";
+        case Operator::eq: case Operator::neq: {
+            const Operand* lhs = &instr.op1;
+            const Operand* rhs = &instr.op2;
+            int c;
+            if (isConstant(*lhs, c) && !isConstant(*rhs, c)) std::swap(lhs, rhs);
+            auto rs1 = getRs1(*lhs);
+            auto rd = getRd(instr.des);
+            // a == b is (a ^ b) == 0, with xori for a constant b, and a == 0 is seqz a
+            long long imm = isConstant(*rhs, c) ? c : 1LL << 32;
+            if (imm == 0) {
+                emit(inst(instr.op == Operator::eq ? rvOPCODE::SEQZ : rvOPCODE::SNEZ, rd, rs1));
+                storeOperand(instr.des, rd);
+                break;
+            }
+            if (fitsImm12(imm)) {
+                emit(inst(rvOPCODE::XORI, rd, rs1, static_cast<int32_t>(imm)));
             } else {
-                fout << "  sltu t2, x0, t2\n";
+                auto rs2 = getRs2(*rhs);
+                emit(inst(rvOPCODE::XOR, rd, rs1, rs2));
             }
-            storeOperand(instr.des, "t2");
+            emit(inst(instr.op == Operator::eq ? rvOPCODE::SEQZ : rvOPCODE::SNEZ, rd, rd));
+            storeOperand(instr.des, rd);
             break;
         }
-        case ir::Operator::_not: {
-            loadOperand(instr.op1, "t0");
-            fout << "  seqz t1, t0   # requires RV64 or pseudo, fallback to xor/sltiu if not available\n";
-            storeOperand(instr.des, "t1");
+        case Operator::_not: {
+            auto rs1 = getRs1(instr.op1);
+            auto rd = getRd(instr.des);
+            emit(inst(rvOPCODE::SEQZ, rd, rs1));
+            storeOperand(instr.des, rd);
             break;
         }
-        case ir::Operator::_and: case ir::Operator::_or: {
-            loadOperand(instr.op1, "t0");
-            loadOperand(instr.op2, "t1");
-            std::string op = (instr.op == ir::Operator::_and ? "and" : "or");
-            fout << "  " << op << " t2, t0, t1\n";
-            storeOperand(instr.des, "t2");
+        case Operator::_and: case Operator::_or: {
+            // logical && and ||, the operands are turned into 0/1 first
+            auto rs1 = getRs1(instr.op1);
+            auto rs2 = getRs2(instr.op2);
+            auto rd = getRd(instr.des);
+            emit(inst(rvOPCODE::SNEZ, t0, rs1));
+            emit(inst(rvOPCODE::SNEZ, t1, rs2));
+            emit(inst(instr.op == Operator::_and ? rvOPCODE::AND : rvOPCODE::OR, rd, t0, t1));
+            storeOperand(instr.des, rd);
             break;
         }
-        case ir::Operator::cvt_i2f: case ir::Operator::cvt_f2i: {
-            // simple conversion: int->float or float->int via fmv
-            int off1 = svmap.find_operand(instr.op1);
-            int offd = svmap.find_operand(instr.des);
-            if (instr.op == ir::Operator::cvt_i2f) {
-                fout << "  lw t0, " << off1 << "(sp)\n";
-                fout << "  fmv.w.x ft0, t0\n";
-                fout << "  fsw ft0, " << offd << "(sp)\n";
-            } else {
-                fout << "  flw ft0, " << off1 << "(sp)\n";
-                fout << "  fmv.x.w t0, ft0\n";
-                fout << "  sw t0, " << offd << "(sp)\n";
-            }
+        case Operator::cvt_i2f: {
+            auto rs1 = getRs1(instr.op1);
+            auto fd = fgetRd(instr.des);
+            emit(inst(rvOPCODE::FCVT_S_W, fd, rs1));
+            fstoreOperand(instr.des, fd);
             break;
         }
-        case ir::Operator::getptr: {
-            int off1 = svmap.find_operand(instr.op1);
-            int idx = std::stoi(instr.op2.name) * 4;
-            int offd = svmap.add_operand(instr.des, 8);
-            fout << "  addi t0, sp, " << off1 << "   # base ptr\n";
-            fout << "  addi t1, t0, " << idx << "   # element ptr\n";
-            fout << "  sw t1, " << offd << "(sp)   # store new ptr\n";
+        case Operator::cvt_f2i: {
+            auto fs1 = fgetRs1(instr.op1);
+            auto rd = getRd(instr.des);
+            emit(inst(rvOPCODE::FCVT_W_S, rd, fs1));
+            storeOperand(instr.des, rd);
             break;
-        }        case ir::Operator::call: {
-            // check if this is a CallInst with arguments
-            const ir::CallInst* callInst = dynamic_cast<const ir::CallInst*>(&instr);
-            if (callInst && !callInst->argumentList.empty()) {
-                // handle function arguments
-                // First 8 args go to registers a0-a7
-                // Additional args go on stack (pushed in reverse order)
-                
-                // First, push args 8+ onto stack (in reverse order for correct access)
-                if (callInst->argumentList.size() > 8) {
-                    for (int i = callInst->argumentList.size() - 1; i >= 8; i--) {
-                        const auto& arg = callInst->argumentList[i];
-                        
-                        // check if this argument is a local array
-                        bool isLocalArray = false;
-                        if (func) {
-                            for (const auto& instPtr : func->InstVec) {
-                                if (instPtr->op == ir::Operator::alloc && instPtr->des.name == arg.name) {
-                                    isLocalArray = true;
-                                    break;
-                                }
-                            }
-                        }
-                          if (isLocalArray && !isGlobalVar(arg)) {
-                            // this is a local array - push its address
-                            int arrayOff = svmap.find_operand(arg);
-                            fout << "  addi t0, sp, " << arrayOff << "   # get array address\n";
-                            fout << "  addi sp, sp, -4\n";  // allocate stack space
-                            fout << "  sw t0, 0(sp)        # push array address\n";
-                        } else if (isGlobalVar(arg)) {
-                            // Check if this is a global array (need to push address)
-                            bool isGlobalArray = false;
-                            for (const auto& gv : program.globalVal) {
-                                if (gv.val.name == arg.name && gv.maxlen > 0) {
-                                    isGlobalArray = true;
-                                    break;
-                                }
-                            }
-                            if (isGlobalArray) {
-                                // this is a global array - push its address
-                                fout << "  la t0, " << arg.name << "   # get global array address\n";
-                                fout << "  addi sp, sp, -4\n";  // allocate stack space
-                                fout << "  sw t0, 0(sp)        # push array address\n";
-                            } else {
-                                // regular global variable - push by value
-                                loadOperand(arg, "t0");
-                                fout << "  addi sp, sp, -4\n";  // allocate stack space
-                                fout << "  sw t0, 0(sp)        # push arg " << i << "\n";
-                            }
-                        } else {
-                            // regular argument - push by value
-                            loadOperand(arg, "t0");
-                            fout << "  addi sp, sp, -4\n";  // allocate stack space
-                            fout << "  sw t0, 0(sp)        # push arg " << i << "\n";
-                        }
-                    }
-                }
-                
-                // Then, load first 8 args into registers a0-a7
-                for (size_t i = 0; i < callInst->argumentList.size() && i < 8; i++) {
-                    std::string argReg = "a" + std::to_string(i);
-                    const auto& arg = callInst->argumentList[i];
-                    
-                    // check if this argument is a local array
-                    bool isLocalArray = false;
-                    if (func) {
-                        for (const auto& instPtr : func->InstVec) {
-                            if (instPtr->op == ir::Operator::alloc && instPtr->des.name == arg.name) {
-                                isLocalArray = true;
-                                break;
-                            }
-                        }
-                    }
-                      if (isLocalArray && !isGlobalVar(arg)) {
-                        // this is a local array - pass its address
-                        int arrayOff = svmap.find_operand(arg);
-                        fout << "  addi " << argReg << ", sp, " << arrayOff << "   # pass array address\n";
-                    } else if (isGlobalVar(arg)) {
-                        // Check if this is a global array (need to pass address)
-                        bool isGlobalArray = false;
-                        for (const auto& gv : program.globalVal) {
-                            if (gv.val.name == arg.name && gv.maxlen > 0) {
-                                isGlobalArray = true;
-                                break;
-                            }
-                        }
-                        if (isGlobalArray) {
-                            // this is a global array - pass its address
-                            fout << "  la " << argReg << ", " << arg.name << "   # pass global array address\n";
-                        } else {
-                            // regular global variable - pass by value
-                            loadOperand(arg, argReg);
-                        }
-                    } else {
-                        // regular argument - pass by value
-                        loadOperand(arg, argReg);
-                    }
+        }
+        case Operator::getptr: {
+            // des = op1 + op2 * 4, op1 can be a global array, a local array or a pointer
+            rvREG base;
+            int off;
+            elemAddr(instr.op1, instr.op2, base, off);
+            auto rd = getRd(instr.des);
+            if (off != 0 || base != rd) {
+                emit(inst(rvOPCODE::ADDI, rd, base, off));
+            }
+            storeOperand(instr.des, rd);
+            break;
+        }
+        case Operator::memset: {
+            // op1[0, op2) = 0, a few words are cleared one by one, larger arrays by a loop
+            rvREG base;
+            int off;
+            elemAddr(instr.op1, Operand("0", Type::IntLiteral), base, off);
+            int cnt;
+            if (isConstant(instr.op2, cnt) && cnt <= 8) {
+                if (!fitsImm12(off + cnt * 4)) {
+                    emit(inst(rvOPCODE::ADDI, t3, base, off));
+                    base = t3;
+                    off = 0;
                 }
-                
-                fout << "  jal ra, " << instr.op1.name << "   # call function with args\n";
-                
-                // Clean up stack space used for args 8+
-                if (callInst->argumentList.size() > 8) {
-                    int stackArgsCount = callInst->argumentList.size() - 8;
-                    fout << "  addi sp, sp, " << (stackArgsCount * 4) << "  # cleanup stack args\n";
+                for (int i = 0; i < cnt; i++) {
+                    emit(inst(rvOPCODE::SW, zero, base, off + i * 4));
                 }
             } else {
-                fout << "  jal ra, " << instr.op1.name << "   # call function\n";
+                std::string label = funcName + "_memset_" + std::to_string(pc);
+                emit(inst(rvOPCODE::ADDI, t0, base, off));     // base ptr
+                auto cnt = getRs2(instr.op2);
+                emit(inst(rvOPCODE::SLLI, t1, cnt, 2));
+                emit(inst(rvOPCODE::ADD, t1, t0, t1));        // end ptr
+                emit(inst(rvOPCODE::BGE, t0, t1, label + "_end"));
+                emit(inst(rvOPCODE::LABEL, label));
+                emit(inst(rvOPCODE::SW, zero, t0, 0));
+                emit(inst(rvOPCODE::ADDI, t0, t0, 4));
+                emit(inst(rvOPCODE::BLT, t0, t1, label));
+                emit(inst(rvOPCODE::LABEL, label + "_end"));
             }
-            int offd = svmap.find_operand(instr.des);
-            fout << "  sw a0, " << offd << "(sp)   # save return value\n";
             break;
-        }case ir::Operator::_goto: {
-            if (instr.op1.name != "null") {
-                loadOperand(instr.op1, "t0");
-                // check if des is a number (relative offset)
-                bool isNumber = true;
-                std::string desName = instr.des.name;
-                // handle negative numbers
-                size_t startPos = 0;
-                if (!desName.empty() && desName[0] == '-') {
-                    startPos = 1;
-                }
-                for (size_t i = startPos; i < desName.length(); i++) {
-                    if (!std::isdigit(desName[i])) {
-                        isNumber = false;
-                        break;
-                    }
-                }
-                if (isNumber && !desName.empty()) {
-                    int offset = std::stoi(desName);
-                    int target = pc + offset;  // relative offset (can be negative)
-                    fout << "  bnez t0, " << funcName << "_label_" << target << "   # conditional goto\n";
+        }
+        case Operator::call: {
+            // the global variables are initialized in .data
+            if (staticGlobalInit && instr.op1.name == "global") {
+                break;
+            }
+            const ir::CallInst* callInst = dynamic_cast<const ir::CallInst*>(&instr);
+            assert(callInst && "call should be a ir::CallInst");
+            if (raSaves.count(pc)) emit(inst(rvOPCODE::SW, ra, sp, 0));
+            const auto& args = callInst->argumentList;
+            // args 8+ are written below sp first, so that sp-relative operands are still found,
+            // sp moves over them right before the call: arg[8] at 0(sp), arg[9] at 4(sp), ...
+            // arrays are passed by address, see getRs
+            int stackArgs = args.size() > 8 ? static_cast<int>(args.size()) - 8 : 0;
+            for (size_t i = 8; i < args.size(); i++) {
+                auto rs = getRs(args[i], t0);
+                emit(inst(rvOPCODE::SW, rs, sp, -4 * stackArgs + static_cast<int>(i - 8) * 4));
+            }
+            // First 8 args go to registers a0-a7, a float of putfloat goes to fa0 as the lib expects
+            // no variable lives in a0-a7 in a function which calls, so writing them in order clobbers no argument
+            for (size_t i = 0; i < args.size() && i < 8; i++) {
+                if (instr.op1.name == "putfloat") {
+                    floadOperand(args[i], fa0);
                 } else {
-                    fout << "  bnez t0, " << desName << "   # conditional goto\n";
-                }
-            } else {
-                // check if des is a number (relative offset)
-                bool isNumber = true;
-                std::string desName = instr.des.name;
-                // handle negative numbers
-                size_t startPos = 0;
-                if (!desName.empty() && desName[0] == '-') {
-                    startPos = 1;
-                }
-                for (size_t i = startPos; i < desName.length(); i++) {
-                    if (!std::isdigit(desName[i])) {
-                        isNumber = false;
-                        break;
-                    }
+                    loadOperand(args[i], argReg(i));
                 }
-                if (isNumber && !desName.empty()) {
-                    int offset = std::stoi(desName);
-                    int target = pc + offset;  // relative offset (can be negative)
-                    fout << "  j " << funcName << "_label_" << target << "   # unconditional goto\n";
+            }
+            if (stackArgs) {
+                adjustSp(-4 * stackArgs);
+            }
+            emit(inst(rvOPCODE::JAL, ra, instr.op1.name));
+            if (stackArgs) {
+                adjustSp(4 * stackArgs);   // cleanup stack args
+            }
+            if (opt::is_var(instr.des)) {
+                if (instr.op1.name == "getfloat") {
+                    fstoreOperand(instr.des, fa0);
                 } else {
-                    fout << "  j " << desName << "   # unconditional goto\n";
+                    storeOperand(instr.des, argReg(0));   // save return value
                 }
             }
             break;
         }
-        case ir::Operator::__unuse__: {
+        case Operator::_goto: {
+            std::string target = funcName + "_label_" + std::to_string(pc + std::stoi(instr.des.name));  // relative offset (can be negative)
+            if (instr.op1.name != "null") {
+                auto cond = getRs1(instr.op1);
+                emit(inst(rvOPCODE::BNEZ, cond, target));
+            } else {
+                emit(inst(rvOPCODE::J, target));
+            }
+            break;
+        }
+        case Operator::__unuse__: {
             // no-op
             break;
         }
         case Operator::alloc: {
-            // skip alloc for global arrays - they're already allocated in .data section
-            if (!isGlobalVar(instr.des)) {
-                int size = std::stoi(instr.op1.name) * 4;
-                svmap.add_operand(instr.des, size);
-                fout << "  # alloc " << instr.des.name << " size=" << size << "\n";
-            }
+            // its slot is given by layoutFrame, global arrays are in .data
             break;
         }
         default:
-            fout << "  # " << instr.draw() << "\n";
+            assert(0 && "unsupported instruction");
     }
 }
 
-// Helper function to check if operand is global variable
-bool backend::Generator::isGlobalVar(const ir::Operand& op) {
-    for (const auto& gv : program.globalVal) {
-        if (gv.val.name == op.name) {
-            return true;
+bool backend::Generator::isConstant(const ir::Operand& op, int& val) const {
+    return opt::get_int_constant(op, constants, val);
+}
+
+backend::SymbolKind backend::Generator::kindOf(const ir::Operand& op) const {
+    auto it = localSymbols.find(op.name);
+    if (it != localSymbols.end()) return it->second;
+    it = globalSymbols.find(op.name);
+    return it != globalSymbols.end() ? it->second : SymbolKind::scalar;
+}
+
+bool backend::Generator::isGlobalVar(const ir::Operand& op) const {
+    return globalSymbols.count(op.name) > 0;
+}
+
+// an array allocated on the stack of curFunc
+bool backend::Generator::isLocalArray(const ir::Operand& op) const {
+    return kindOf(op) == SymbolKind::localArray;
+}
+
+rv::rvREG backend::Generator::getRd(ir::Operand op) {
+    auto it = regs.reg.find(op.name);
+    return it != regs.reg.end() && op.type != ir::Type::Float ? it->second : t2;
+}
+
+rv::rvFREG backend::Generator::fgetRd(ir::Operand op) {
+    auto it = regs.freg.find(op.name);
+    return it != regs.freg.end() && op.type == ir::Type::Float ? it->second : ft2;
+}
+
+rv::rvREG backend::Generator::getRs1(ir::Operand op) {
+    return getRs(op, t0);
+}
+
+rv::rvREG backend::Generator::getRs2(ir::Operand op) {
+    return getRs(op, t1);
+}
+
+rv::rvFREG backend::Generator::fgetRs1(ir::Operand op) {
+    return fgetRs(op, ft0);
+}
+
+rv::rvFREG backend::Generator::fgetRs2(ir::Operand op) {
+    return fgetRs(op, ft1);
+}
+
+// the register holding an int operand, an array operand gives its address
+rv::rvREG backend::Generator::getRs(const ir::Operand& op, rv::rvREG scratch) {
+    int imm;
+    if (isConstant(op, imm) && !regs.reg.count(op.name)) {
+        if (imm == 0) return zero;
+        loadImm(scratch, imm);
+    } else if (op.type == ir::Type::FloatLiteral) {
+        loadImm(scratch, static_cast<int32_t>(floatBits(op)));
+    } else if (regs.reg.count(op.name)) {
+        return regs.reg.at(op.name);
+    } else if (regs.freg.count(op.name)) {
+        emit(inst(rvOPCODE::FMV_X_W, scratch, regs.freg.at(op.name)));
+    } else if (isGlobalVar(op)) {
+        emit(inst(kindOf(op) == SymbolKind::globalArray ? rvOPCODE::LA : rvOPCODE::LW, scratch, op.name));
+    } else if (isLocalArray(op)) {
+        int off = svmap.find_operand(op);
+        if (fitsImm12(off)) {
+            emit(inst(rvOPCODE::ADDI, scratch, sp, off));
+        } else {
+            loadImm(scratch, off);
+            emit(inst(rvOPCODE::ADD, scratch, sp, scratch));
         }
+    } else {
+        rvREG base;
+        int off;
+        stackSlot(svmap.find_operand(op), scratch, base, off);
+        emit(inst(rvOPCODE::LW, scratch, base, off));
     }
-    return false;
+    return scratch;
 }
 
-// Helper function to load operand (global or local)
-void backend::Generator::loadOperand(const ir::Operand& op, const std::string& reg) {
-    if (op.type == ir::Type::IntLiteral) {
-        // Load integer constant
-        fout << "  li " << reg << ", " << op.name << "\n";
+// the register holding a float operand, an int literal is converted
+rv::rvFREG backend::Generator::fgetRs(const ir::Operand& op, rv::rvFREG scratch) {
+    if (op.type == ir::Type::IntLiteral || op.type == ir::Type::FloatLiteral) {
+        loadImm(t3, static_cast<int32_t>(floatBits(op)));
+        emit(inst(rvOPCODE::FMV_W_X, scratch, t3));
+    } else if (regs.freg.count(op.name)) {
+        return regs.freg.at(op.name);
+    } else if (regs.reg.count(op.name)) {
+        emit(inst(rvOPCODE::FMV_W_X, scratch, regs.reg.at(op.name)));
     } else if (isGlobalVar(op)) {
-        fout << "  lw " << reg << ", " << op.name << "\n";
+        emit(inst(rvOPCODE::LA, t3, op.name));
+        emit(inst(rvOPCODE::FLW, scratch, t3, 0));
     } else {
-        int off = svmap.find_operand(op);
-        fout << "  lw " << reg << ", " << off << "(sp)\n";
+        rvREG base;
+        int off;
+        stackSlot(svmap.find_operand(op), t3, base, off);
+        emit(inst(rvOPCODE::FLW, scratch, base, off));
+    }
+    return scratch;
+}
+
+void backend::Generator::loadOperand(const ir::Operand& op, rv::rvREG reg) {
+    auto rs = getRs(op, reg);
+    if (rs != reg) {
+        emit(inst(rvOPCODE::MOV, reg, rs));
     }
 }
 
-// Helper function to store to operand (global or local)
-void backend::Generator::storeOperand(const ir::Operand& op, const std::string& reg) {
-    if (isGlobalVar(op)) {
-        fout << "  la t3, " << op.name << "\n";
-        fout << "  sw " << reg << ", 0(t3)\n";
+void backend::Generator::storeOperand(const ir::Operand& op, rv::rvREG reg) {
+    if (regs.reg.count(op.name)) {
+        if (regs.reg.at(op.name) != reg) emit(inst(rvOPCODE::MOV, regs.reg.at(op.name), reg));
+    } else if (regs.freg.count(op.name)) {
+        emit(inst(rvOPCODE::FMV_W_X, regs.freg.at(op.name), reg));
+    } else if (isGlobalVar(op)) {
+        emit(inst(rvOPCODE::LA, t3, op.name));
+        emit(inst(rvOPCODE::SW, reg, t3, 0));
     } else {
-        int off = svmap.find_operand(op);
-        fout << "  sw " << reg << ", " << off << "(sp)\n";
+        rvREG base;
+        int off;
+        stackSlot(svmap.find_operand(op), t3, base, off);
+        emit(inst(rvOPCODE::SW, reg, base, off));
+    }
+}
+
+void backend::Generator::floadOperand(const ir::Operand& op, rv::rvFREG reg) {
+    auto fs = fgetRs(op, reg);
+    if (fs != reg) {
+        emit(inst(rvOPCODE::FMV_S, reg, fs));
+    }
+}
+
+void backend::Generator::fstoreOperand(const ir::Operand& op, rv::rvFREG reg) {
+    if (regs.freg.count(op.name)) {
+        if (regs.freg.at(op.name) != reg) emit(inst(rvOPCODE::FMV_S, regs.freg.at(op.name), reg));
+    } else if (regs.reg.count(op.name)) {
+        emit(inst(rvOPCODE::FMV_X_W, regs.reg.at(op.name), reg));
+    } else if (isGlobalVar(op)) {
+        emit(inst(rvOPCODE::LA, t3, op.name));
+        emit(inst(rvOPCODE::FSW, reg, t3, 0));
+    } else {
+        rvREG base;
+        int off;
+        stackSlot(svmap.find_operand(op), t3, base, off);
+        emit(inst(rvOPCODE::FSW, reg, base, off));
+    }
+}
+
+void backend::Generator::elemAddr(const ir::Operand& arr, const ir::Operand& idx, rv::rvREG& base, int& off) {
+    off = 0;
+    if (isGlobalVar(arr)) {
+        emit(inst(rvOPCODE::LA, t3, arr.name));
+        base = t3;
+    } else if (isLocalArray(arr)) {
+        base = sp;
+        off = svmap.find_operand(arr);
+    } else {
+        base = getRs(arr, t3);      // a pointer
+    }
+    int idxVal;
+    if (isConstant(idx, idxVal)) {
+        long long total = off + 4LL * idxVal;
+        if (fitsImm12(total)) {
+            off = static_cast<int>(total);
+        } else {
+            loadImm(t1, static_cast<int32_t>(total));
+            emit(inst(rvOPCODE::ADD, t3, base, t1));
+            base = t3;
+            off = 0;
+        }
+    } else {
+        auto ri = getRs(idx, t1);
+        emit(inst(rvOPCODE::SLLI, t1, ri, 2));
+        emit(inst(rvOPCODE::ADD, t3, base, t1));
+        base = t3;
+        // the slot of a local array may be out of reach of the offset
+        if (!fitsImm12(off)) {
+            loadImm(t1, off);
+            emit(inst(rvOPCODE::ADD, t3, t3, t1));
+            off = 0;
+        }
     }
 }
 
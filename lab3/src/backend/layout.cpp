@@ -0,0 +1,316 @@
+#include "backend/layout.h"
+
+#include<set>
+#include<cassert>
+#include<algorithm>
+
+using rv::rvOPCODE;
+using rv::rv_inst;
+
+namespace {
+
+// the largest block, not counting its labels and branch, which is copied in place of a jump to it
+const size_t maxDuplicated = 4;
+
+bool isBranch(rvOPCODE op) {
+    switch (op) {
+        case rvOPCODE::BEQ: case rvOPCODE::BNE: case rvOPCODE::BLT: case rvOPCODE::BGE:
+        case rvOPCODE::BLTU: case rvOPCODE::BGEU: case rvOPCODE::BEQZ: case rvOPCODE::BNEZ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// the branch taken exactly when op is not
+rvOPCODE inverse(rvOPCODE op) {
+    switch (op) {
+        case rvOPCODE::BEQ:  return rvOPCODE::BNE;
+        case rvOPCODE::BNE:  return rvOPCODE::BEQ;
+        case rvOPCODE::BLT:  return rvOPCODE::BGE;
+        case rvOPCODE::BGE:  return rvOPCODE::BLT;
+        case rvOPCODE::BLTU: return rvOPCODE::BGEU;
+        case rvOPCODE::BGEU: return rvOPCODE::BLTU;
+        case rvOPCODE::BEQZ: return rvOPCODE::BNEZ;
+        case rvOPCODE::BNEZ: return rvOPCODE::BEQZ;
+        default:
+            assert(0 && "not a conditional branch");
+            return op;
+    }
+}
+
+// a straight-line run of the code, the successors are indices of blocks in the original order
+struct Block {
+    std::vector<std::string> labels;
+    std::vector<rv_inst> body;          // without the labels and the final branch or jump, a jr stays in it
+    bool hasBranch = false;
+    rv_inst branch;                     // the conditional branch to taken, if hasBranch
+    int taken = -1;
+    int next = -1;                      // where it goes when the branch is not taken, -1 after a jr
+    bool jumps = false;                 // it reaches next by a jump, not by falling through
+    double weight = -1;                 // execution count, -1 if unknown
+    double takenRatio = 0.5;            // the part of weight which goes to taken
+};
+
+// an upper bound of the bytes of ri once assembled, a pseudo instruction may expand to two
+int32_t sizeOf(const rv_inst& ri) {
+    switch (ri.op) {
+        case rvOPCODE::LABEL:
+            return 0;
+        case rvOPCODE::LA:
+            return 8;
+        case rvOPCODE::LI:
+            return ri.imm >= -2048 && ri.imm < 2048 ? 4 : 8;
+        case rvOPCODE::LW:
+            return ri.label.empty() ? 4 : 8;
+        default:
+            return 4;
+    }
+}
+
+// a conditional branch reaches -4096..4094 bytes from itself, one to a label farther than that is inverted to skip
+// a jump to it, which reaches +-1 MiB; the distances only grow, so it is repeated until none is too far
+void relaxBranches(std::vector<rv_inst>& code, const std::string& name) {
+    int fresh = 0;
+    for (bool changed = true; changed; ) {
+        changed = false;
+        std::map<std::string, int32_t> labelPos;
+        std::vector<int32_t> pos(code.size());
+        int32_t at = 0;
+        for (size_t k = 0; k < code.size(); k++) {
+            pos[k] = at;
+            if (code[k].op == rvOPCODE::LABEL) labelPos[code[k].label] = at;
+            at += sizeOf(code[k]);
+        }
+        std::vector<rv_inst> res;
+        res.reserve(code.size());
+        for (size_t k = 0; k < code.size(); k++) {
+            const auto& ri = code[k];
+            if (!isBranch(ri.op)) {
+                res.push_back(ri);
+                continue;
+            }
+            int32_t dist = labelPos.at(ri.label) - pos[k];
+            if (dist >= -4096 && dist <= 4094) {
+                res.push_back(ri);
+                continue;
+            }
+            auto skip = name + "_far_" + std::to_string(fresh++);
+            auto br = ri;
+            br.op = inverse(ri.op);
+            br.label = skip;
+            res.push_back(br);
+            res.push_back(rv::inst(rvOPCODE::J, ri.label));
+            res.push_back(rv::inst(rvOPCODE::LABEL, skip));
+            changed = true;
+        }
+        code = std::move(res);
+    }
+}
+
+} // namespace
+
+void backend::layoutBlocks(std::vector<rv::rv_inst>& code, const std::string& name, const std::map<std::string, uint64_t>& counts) {
+    // split at the labels and after the branches and jumps, code after a jump without a label is unreachable
+    std::vector<Block> blocks;
+    std::vector<std::string> jumpTarget;
+    bool open = false;
+    auto start = [&]() {
+        blocks.emplace_back();
+        jumpTarget.emplace_back();
+        open = true;
+    };
+    start();
+    for (const auto& ri : code) {
+        if (!open) start();
+        if (ri.op == rvOPCODE::LABEL) {
+            if (!blocks.back().body.empty()) {
+                blocks.back().next = static_cast<int>(blocks.size());
+                start();
+            }
+            blocks.back().labels.push_back(ri.label);
+            continue;
+        }
+        auto& b = blocks.back();
+        if (ri.op == rvOPCODE::J) {
+            jumpTarget.back() = ri.label;
+            b.jumps = true;
+            open = false;
+        } else if (isBranch(ri.op)) {
+            b.hasBranch = true;
+            b.branch = ri;
+            b.next = static_cast<int>(blocks.size());
+            open = false;
+        } else {
+            b.body.push_back(ri);
+            if (ri.op == rvOPCODE::JR) open = false;
+        }
+    }
+    int n = static_cast<int>(blocks.size());
+    std::map<std::string, int> blockOf;
+    for (int i = 0; i < n; i++) {
+        for (const auto& label : blocks[i].labels) blockOf[label] = i;
+    }
+    for (int i = 0; i < n; i++) {
+        auto& b = blocks[i];
+        if (b.jumps) b.next = blockOf.at(jumpTarget[i]);
+        if (b.hasBranch) b.taken = blockOf.at(b.branch.label);
+        assert(b.next < n && "the code of a function falls through its end");
+    }
+
+    // a block which only jumps or falls through is skipped by the edges into it
+    auto forward = [&](int i) {
+        std::set<int> seen;
+        while (i >= 0 && blocks[i].body.empty() && !blocks[i].hasBranch && blocks[i].next >= 0 && seen.insert(i).second) {
+            i = blocks[i].next;
+        }
+        return i;
+    };
+    for (auto& b : blocks) {
+        if (b.next >= 0) b.next = forward(b.next);
+        if (b.hasBranch) b.taken = forward(b.taken);
+        if (b.hasBranch && b.taken == b.next) b.hasBranch = false;
+    }
+    // the profile estimate of the blocks: the counts of the labeled blocks, the others get the weight of the edge into
+    // them, which comes from the block before them as nothing jumps to a block without a label; a successor with
+    // a count and no other predecessor gives the split of a branch, else it is even
+    bool profiled = !counts.empty();
+    if (profiled) {
+        std::vector<int> preds(n, 0);
+        for (const auto& b : blocks) {
+            if (b.hasBranch) preds[b.taken]++;
+            if (b.next >= 0) preds[b.next]++;
+        }
+        auto it = counts.find(name);
+        if (it != counts.end()) blocks[0].weight = static_cast<double>(it->second);
+        for (auto& b : blocks) {
+            for (const auto& label : b.labels) {
+                auto c = counts.find(label);
+                if (c != counts.end()) b.weight = std::max(b.weight, static_cast<double>(c->second));
+            }
+        }
+        double intoNext = 0;
+        for (int i = 0; i < n; i++) {
+            auto& b = blocks[i];
+            if (b.weight < 0) b.weight = intoNext;
+            intoNext = 0;
+            if (b.hasBranch && b.weight > 0) {
+                const auto& t = blocks[b.taken];
+                const auto& f = blocks[b.next];
+                if (preds[b.taken] == 1 && t.weight >= 0) b.takenRatio = std::min(1.0, t.weight / b.weight);
+                else if (preds[b.next] == 1 && f.weight >= 0) b.takenRatio = 1 - std::min(1.0, f.weight / b.weight);
+            }
+            if (b.next == i + 1) intoNext = b.weight * (b.hasBranch ? 1 - b.takenRatio : 1);
+        }
+    }
+
+    // a jump to a small conditional block takes a copy of it: a loop which jumps back to its test at the top
+    // then tests at the bottom, and the jump to the top is gone
+    for (int i = 0; i < n; i++) {
+        auto& b = blocks[i];
+        if (!b.jumps || b.hasBranch || b.next < 0 || b.next == i) continue;
+        auto& h = blocks[b.next];
+        if (!h.hasBranch || h.body.size() > maxDuplicated) continue;
+        b.body.insert(b.body.end(), h.body.begin(), h.body.end());
+        b.hasBranch = true;
+        b.branch = h.branch;
+        b.takenRatio = h.takenRatio;
+        b.taken = h.taken;
+        b.next = h.next;
+        // the copy now runs what went through the jump
+        if (profiled) h.weight = std::max(0.0, h.weight - b.weight);
+    }
+
+    // the blocks reachable from the entry
+    std::vector<bool> reached(n, false);
+    std::vector<int> stack = {0};
+    reached[0] = true;
+    while (!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+        for (int s : {blocks[i].hasBranch ? blocks[i].taken : -1, blocks[i].next}) {
+            if (s >= 0 && !reached[s]) {
+                reached[s] = true;
+                stack.push_back(s);
+            }
+        }
+    }
+
+    // the original order, or with a profile the chains of the heaviest edges, the entry first
+    std::vector<int> order;
+    if (!profiled) {
+        for (int i = 0; i < n; i++) {
+            if (reached[i]) order.push_back(i);
+        }
+    } else {
+        struct Edge { int from, to; double weight; };
+        std::vector<Edge> edges;
+        for (int i = 0; i < n; i++) {
+            const auto& b = blocks[i];
+            if (!reached[i]) continue;
+            if (b.hasBranch) {
+                edges.push_back({i, b.taken, b.weight * b.takenRatio});
+                edges.push_back({i, b.next, b.weight * (1 - b.takenRatio)});
+            } else if (b.next >= 0) {
+                edges.push_back({i, b.next, b.weight});
+            }
+        }
+        // ties keep the original order
+        std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+            if (a.weight != b.weight) return a.weight > b.weight;
+            return (a.to == a.from + 1) > (b.to == b.from + 1);
+        });
+        std::vector<int> after(n, -1), before(n, -1);
+        auto headOf = [&](int i) {
+            while (before[i] >= 0) i = before[i];
+            return i;
+        };
+        // a back edge does not fall through, the loops are already tested at the bottom
+        for (const auto& e : edges) {
+            if (e.to <= e.from || after[e.from] >= 0 || before[e.to] >= 0 || headOf(e.from) == e.to) continue;
+            after[e.from] = e.to;
+            before[e.to] = e.from;
+        }
+        for (int i = 0; i < n; i++) {
+            if (!reached[i] || before[i] >= 0) continue;
+            for (int j = i; j >= 0; j = after[j]) order.push_back(j);
+        }
+    }
+
+    // the branches and jumps for the new order, the fall through is the block placed next
+    std::vector<std::vector<std::pair<rv_inst, int>>> exits(n);     // instruction -> the block it goes to
+    std::set<int> targets;
+    for (size_t k = 0; k < order.size(); k++) {
+        int i = order[k];
+        int placedNext = k + 1 < order.size() ? order[k + 1] : -1;
+        const auto& b = blocks[i];
+        if (b.hasBranch) {
+            auto br = b.branch;
+            if (b.taken == placedNext) {
+                br.op = inverse(br.op);
+                exits[i].push_back({br, b.next});
+            } else {
+                exits[i].push_back({br, b.taken});
+                if (b.next != placedNext) exits[i].push_back({rv::inst(rvOPCODE::J, ""), b.next});
+            }
+        } else if (b.next >= 0 && b.next != placedNext) {
+            exits[i].push_back({rv::inst(rvOPCODE::J, ""), b.next});
+        }
+        for (const auto& e : exits[i]) targets.insert(e.second);
+    }
+    auto labelOf = [&](int i) {
+        return blocks[i].labels.empty() ? name + "_bb_" + std::to_string(i) : blocks[i].labels.front();
+    };
+    code.clear();
+    for (int i : order) {
+        const auto& b = blocks[i];
+        for (const auto& label : b.labels) code.push_back(rv::inst(rvOPCODE::LABEL, label));
+        if (b.labels.empty() && targets.count(i)) code.push_back(rv::inst(rvOPCODE::LABEL, labelOf(i)));
+        code.insert(code.end(), b.body.begin(), b.body.end());
+        for (auto e : exits[i]) {
+            e.first.label = labelOf(e.second);
+            code.push_back(e.first);
+        }
+    }
+    relaxBranches(code, name);
+}
@@ -0,0 +1,165 @@
+#include "backend/peephole.h"
+
+#include<map>
+#include<cstdint>
+#include<string>
+
+using rv::rvREG;
+using rv::rvFREG;
+using rv::rvOPCODE;
+using rv::rv_inst;
+
+namespace {
+
+// the float register written by ri
+bool floatDef(const rv_inst& ri, rvFREG& fd) {
+    switch (ri.op) {
+        case rvOPCODE::FLW: case rvOPCODE::FADD_S: case rvOPCODE::FSUB_S: case rvOPCODE::FMUL_S: case rvOPCODE::FDIV_S:
+        case rvOPCODE::FCVT_S_W: case rvOPCODE::FMV_W_X: case rvOPCODE::FMV_S:
+            fd = ri.frd;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// what the registers are known to hold at a point of a basic block
+struct BlockState {
+    std::map<int, rvREG> slot;                  // sp offset -> the register holding the word there
+    std::map<int, rvFREG> fslot;
+    std::map<rvREG, rv_inst> value;             // register -> the li or la which set it
+
+    void clear() {
+        slot.clear();
+        fslot.clear();
+        value.clear();
+    }
+
+    void clearMemory() {
+        slot.clear();
+        fslot.clear();
+    }
+
+    void kill(rvREG r) {
+        value.erase(r);
+        for (auto it = slot.begin(); it != slot.end(); ) {
+            if (it->second == r) it = slot.erase(it);
+            else it++;
+        }
+    }
+
+    void kill(rvFREG r) {
+        for (auto it = fslot.begin(); it != fslot.end(); ) {
+            if (it->second == r) it = fslot.erase(it);
+            else it++;
+        }
+    }
+
+    // the word at off(sp) is changed
+    void store(int off) {
+        slot.erase(off);
+        fslot.erase(off);
+    }
+};
+
+bool sameValue(const rv_inst& a, const rv_inst& b) {
+    return a.op == b.op && (a.op == rvOPCODE::LI ? a.imm == b.imm : a.label == b.label);
+}
+
+} // namespace
+
+void backend::peephole(std::vector<rv::rv_inst>& code) {
+    const rvREG zero = rvREG::X0, sp = rvREG::X2;
+    std::vector<rv_inst> res;
+    BlockState state;
+    for (size_t i = 0; i < code.size(); i++) {
+        auto ri = code[i];
+        switch (ri.op) {
+            case rvOPCODE::LABEL:
+                state.clear();
+                break;
+            case rvOPCODE::JAL: case rvOPCODE::JALR:
+                // the callee may change every caller-saved register and the memory
+                res.push_back(ri);
+                state.clear();
+                continue;
+            case rvOPCODE::LI: case rvOPCODE::LA: {
+                auto it = state.value.find(ri.rd);
+                if (it != state.value.end() && sameValue(it->second, ri)) continue;
+                res.push_back(ri);
+                state.kill(ri.rd);
+                state.value[ri.rd] = ri;
+                continue;
+            }
+            case rvOPCODE::LUI: {
+                // lui and the addi completing it make a li of a large constant
+                bool pair = i + 1 < code.size() && code[i + 1].op == rvOPCODE::ADDI
+                         && code[i + 1].rd == ri.rd && code[i + 1].rs1 == ri.rd;
+                // added as uint32_t, the sum wraps like the registers do
+                uint32_t bits = (static_cast<uint32_t>(ri.imm) << 12) + static_cast<uint32_t>(pair ? code[i + 1].imm : 0);
+                auto value = rv::inst(rvOPCODE::LI, ri.rd, static_cast<int32_t>(bits));
+                auto it = state.value.find(ri.rd);
+                if (it == state.value.end() || !sameValue(it->second, value)) {
+                    res.push_back(ri);
+                    if (pair) res.push_back(code[i + 1]);
+                    state.kill(ri.rd);
+                    state.value[ri.rd] = value;
+                }
+                if (pair) i++;
+                continue;
+            }
+            case rvOPCODE::MOV:
+                if (ri.rd == ri.rs1) continue;
+                break;
+            case rvOPCODE::FMV_S:
+                if (ri.frd == ri.frs1) continue;
+                break;
+            case rvOPCODE::SW: case rvOPCODE::FSW:
+                res.push_back(ri);
+                if (ri.rs1 != sp) {
+                    // it may write an array on the stack through a pointer
+                    state.clearMemory();
+                } else {
+                    state.store(ri.imm);
+                    if (ri.op == rvOPCODE::SW) state.slot[ri.imm] = ri.rs2;
+                    else state.fslot[ri.imm] = ri.frs2;
+                }
+                continue;
+            case rvOPCODE::LW:
+                if (ri.label.empty() && ri.rs1 == sp && state.slot.count(ri.imm)) {
+                    auto r = state.slot[ri.imm];
+                    if (r == ri.rd) continue;
+                    ri = rv::inst(rvOPCODE::MOV, ri.rd, r);
+                    res.push_back(ri);
+                    state.kill(ri.rd);
+                    continue;
+                }
+                res.push_back(ri);
+                state.kill(ri.rd);
+                if (ri.label.empty() && ri.rs1 == sp) state.slot[ri.imm] = ri.rd;
+                continue;
+            case rvOPCODE::FLW:
+                if (ri.rs1 == sp && state.fslot.count(ri.imm)) {
+                    auto r = state.fslot[ri.imm];
+                    if (r == ri.frd) continue;
+                    ri = rv::inst(rvOPCODE::FMV_S, ri.frd, r);
+                    res.push_back(ri);
+                    state.kill(ri.frd);
+                    continue;
+                }
+                res.push_back(ri);
+                state.kill(ri.frd);
+                if (ri.rs1 == sp) state.fslot[ri.imm] = ri.frd;
+                continue;
+            default:
+                break;
+        }
+        res.push_back(ri);
+        rvFREG fd;
+        if (ri.rd != zero) state.kill(ri.rd);
+        if (floatDef(ri, fd)) state.kill(fd);
+        // the slots are addressed from another sp then
+        if (ri.rd == sp) state.clearMemory();
+    }
+    code = std::move(res);
+}
@@ -0,0 +1,688 @@
+#include"backend/regalloc.h"
+#include"opt/cfg.h"
+#include"opt/loop.h"
+#include"opt/liveness.h"
+#include"opt/ir_util.h"
+
+#include<cmath>
+#include<cstdint>
+#include<algorithm>
+#include<unordered_set>
+
+backend::FunctionLiveness::FunctionLiveness(const ir::Function& func, const std::set<std::string>& globals) {
+    // which names may live in a register: scalars of a single register class, not arrays or globals
+    std::map<std::string, std::set<bool>> classes;
+    std::set<std::string> excluded(globals);
+    auto note = [&](const ir::Operand& op) {
+        if (!opt::is_var(op)) return;
+        classes[op.name].insert(op.type == ir::Type::Float);
+    };
+    for (const auto& param: func.ParameterList) note(param);
+    for (auto inst: func.InstVec) {
+        if (inst->op == ir::Operator::alloc) {
+            excluded.insert(inst->des.name);
+            continue;
+        }
+        for (const auto& use: opt::uses_of(inst)) note(use);
+        auto def = opt::def_of(inst);
+        if (def) note(*def);
+    }
+    for (const auto& it: classes) {
+        if (it.second.size() == 1 && !excluded.count(it.first)) candidates[it.first] = *it.second.begin();
+    }
+    auto keep = [&](const std::set<std::string>& live) {
+        std::set<std::string> res;
+        for (const auto& name: live) {
+            if (candidates.count(name)) res.insert(name);
+        }
+        return res;
+    };
+
+    std::map<const ir::Instruction*, int> pcOf;
+    for (size_t i = 0; i < func.InstVec.size(); i++) pcOf[func.InstVec[i]] = i;
+    liveAfter.resize(func.InstVec.size());
+    loopDepth.resize(func.InstVec.size(), 0);
+
+    // the cfg only reads func
+    opt::CFG cfg(const_cast<ir::Function*>(&func));
+    opt::DomTree dom(cfg);
+    opt::LoopInfo loops(cfg, dom);
+    opt::Liveness live(cfg, globals);
+    for (auto bb: cfg.blocks) {
+        std::set<std::string> after = live.live_out[bb->index];
+        for (auto it = bb->insts.rbegin(); it != bb->insts.rend(); ++it) {
+            int pc = pcOf[*it];
+            liveAfter[pc] = keep(after);
+            loopDepth[pc] = loops.depth_of(bb);
+            opt::Liveness::step(*it, after, globals);
+        }
+    }
+    // parameters arrive at the entry
+    if (!cfg.blocks.empty()) liveAtEntry = keep(live.live_in[cfg.blocks.front()->index]);
+    for (const auto& param: func.ParameterList) {
+        if (candidates.count(param.name)) liveAtEntry.insert(param.name);
+    }
+}
+
+std::vector<backend::LiveInterval> backend::liveIntervals(const ir::Function& func, const FunctionLiveness& live) {
+    std::map<std::string, LiveInterval> res;
+    auto cover = [&](const std::string& name, int pc) {
+        auto c = live.candidates.find(name);
+        if (c == live.candidates.end()) return;
+        auto it = res.find(name);
+        if (it == res.end()) {
+            res[name] = {name, c->second, pc, pc, false};
+            return;
+        }
+        it->second.start = std::min(it->second.start, pc);
+        it->second.end = std::max(it->second.end, pc);
+    };
+    for (const auto& name: live.liveAtEntry) cover(name, 0);
+    for (size_t pc = 0; pc < func.InstVec.size(); pc++) {
+        auto inst = func.InstVec[pc];
+        auto def = opt::def_of(inst);
+        // live after pc or used by it, which covers all live before pc
+        for (const auto& name: live.liveAfter[pc]) {
+            cover(name, pc);
+            if (inst->op == ir::Operator::call && (!def || def->name != name)) res[name].crossesCall = true;
+        }
+        for (const auto& use: opt::uses_of(inst)) cover(use.name, pc);
+        if (def) cover(def->name, pc);
+    }
+
+    std::vector<LiveInterval> intervals;
+    for (const auto& it: res) intervals.push_back(it.second);
+    std::stable_sort(intervals.begin(), intervals.end(), [](const LiveInterval& a, const LiveInterval& b) {
+        return a.start < b.start;
+    });
+    return intervals;
+}
+
+namespace {
+
+// linear scan of the intervals of one register class
+template<typename REG>
+struct LinearScan {
+    const std::vector<REG>& callerSaved;
+    const std::vector<REG>& calleeSaved;
+    std::map<std::string, REG>& assigned;
+    std::set<REG> usedCalleeSaved;
+    std::map<std::string, REG> hints;           // the register a parameter arrives in
+
+    struct Active {
+        const backend::LiveInterval* interval;
+        REG reg;
+    };
+    std::vector<Active> active;                 // sorted by end
+    std::set<REG> free;
+
+    LinearScan(const std::vector<REG>& caller, const std::vector<REG>& callee, std::map<std::string, REG>& res)
+        : callerSaved(caller), calleeSaved(callee), assigned(res) {
+        free.insert(caller.begin(), caller.end());
+        free.insert(callee.begin(), callee.end());
+    }
+
+    bool isCalleeSaved(REG r) const {
+        return std::find(calleeSaved.begin(), calleeSaved.end(), r) != calleeSaved.end();
+    }
+
+    void take(const backend::LiveInterval* interval, REG r) {
+        free.erase(r);
+        assigned[interval->name] = r;
+        if (isCalleeSaved(r)) usedCalleeSaved.insert(r);
+        auto pos = std::find_if(active.begin(), active.end(), [&](const Active& a) { return a.interval->end > interval->end; });
+        active.insert(pos, {interval, r});
+    }
+
+    void run(const std::vector<const backend::LiveInterval*>& intervals) {
+        for (auto interval: intervals) {
+            // expire the intervals which end before this one starts
+            while (!active.empty() && active.front().interval->end < interval->start) {
+                free.insert(active.front().reg);
+                active.erase(active.begin());
+            }
+
+            // prefer a caller-saved register when the value does not live across a call, it costs no save/restore
+            bool found = false;
+            if (!interval->crossesCall) {
+                auto hint = hints.find(interval->name);
+                if (hint != hints.end() && free.count(hint->second)) {
+                    take(interval, hint->second);
+                    found = true;
+                }
+                for (auto r: callerSaved) {
+                    if (!found && free.count(r)) {
+                        take(interval, r);
+                        found = true;
+                        break;
+                    }
+                }
+            }
+            // then a callee-saved one which is already saved, then any callee-saved one
+            for (int pass = 0; pass < 2 && !found; pass++) {
+                for (auto r: calleeSaved) {
+                    if (free.count(r) && (pass || usedCalleeSaved.count(r))) {
+                        take(interval, r);
+                        found = true;
+                        break;
+                    }
+                }
+            }
+            if (found) continue;
+
+            // spill the active interval ending last, if it ends after this one and its register fits
+            for (auto it = active.rbegin(); it != active.rend(); ++it) {
+                if (it->interval->end <= interval->end) break;
+                if (interval->crossesCall && !isCalleeSaved(it->reg)) continue;
+                auto r = it->reg;
+                assigned.erase(it->interval->name);
+                active.erase(std::next(it).base());
+                free.insert(r);
+                take(interval, r);
+                break;
+            }
+        }
+    }
+};
+
+// the int registers which need no save, see allocateRegisters
+std::vector<rv::rvREG> intCallerSaved(bool leaf) {
+    auto res = backend::callerSavedRegs;
+    if (leaf) res.insert(res.end(), backend::argRegs.begin(), backend::argRegs.end());
+    return res;
+}
+
+// the argument register of each int parameter of a leaf function
+std::map<std::string, rv::rvREG> paramHints(const ir::Function& func, bool leaf) {
+    std::map<std::string, rv::rvREG> res;
+    if (!leaf) return res;
+    for (size_t i = 0; i < func.ParameterList.size() && i < backend::argRegs.size(); i++) {
+        const auto& param = func.ParameterList[i];
+        if (param.type != ir::Type::Float) res[param.name] = backend::argRegs[i];
+    }
+    return res;
+}
+
+// linearScan over the liveness of func computed already
+backend::RegAssignment linearScanOf(const ir::Function& func, const backend::FunctionLiveness& live, bool leaf) {
+    auto intervals = backend::liveIntervals(func, live);
+    std::vector<const backend::LiveInterval*> ints, floats;
+    for (const auto& interval: intervals) (interval.isFloat ? floats : ints).push_back(&interval);
+
+    backend::RegAssignment res;
+    auto callerSaved = intCallerSaved(leaf);
+    LinearScan<rv::rvREG> intScan(callerSaved, backend::calleeSavedRegs, res.reg);
+    intScan.hints = paramHints(func, leaf);
+    intScan.run(ints);
+    LinearScan<rv::rvFREG> floatScan(backend::callerSavedFRegs, backend::calleeSavedFRegs, res.freg);
+    floatScan.run(floats);
+    res.usedCalleeSaved.assign(intScan.usedCalleeSaved.begin(), intScan.usedCalleeSaved.end());
+    res.usedCalleeSavedF.assign(floatScan.usedCalleeSaved.begin(), floatScan.usedCalleeSaved.end());
+    return res;
+}
+
+} // namespace
+
+backend::RegAssignment backend::linearScan(const ir::Function& func, const std::set<std::string>& globals, bool leaf) {
+    return linearScanOf(func, FunctionLiveness(func, globals), leaf);
+}
+
+namespace {
+
+// iterated register coalescing of the variables of one register class, following Appel's
+// "Modern Compiler Implementation", nodes [0, P) are the caller-saved registers, precolored;
+// the interference graph is a hashed edge set and adjacency lists, so it grows with the edges, not with n * n
+template<typename REG>
+class GraphColoring {
+public:
+    GraphColoring(const std::vector<REG>& callerSaved, const std::vector<REG>& calleeSaved)
+        : precolored(callerSaved.size()) {
+        regs = callerSaved;
+        regs.insert(regs.end(), calleeSaved.begin(), calleeSaved.end());
+        K = regs.size();
+    }
+
+    // variables are added as nodes P, P + 1, ... before any edge or move
+    int addNode(const std::string& name) {
+        names.push_back(name);
+        return precolored + names.size() - 1;
+    }
+
+    void finishNodes() {
+        n = precolored + names.size();
+        adjList.assign(n, {});
+        inGraph.assign(n, {});
+        degree.assign(n, 0);
+        moveList.assign(n, {});
+        liveMoves.assign(n, 0);
+        alias.assign(n, -1);
+        color.assign(n, -1);
+        hint.assign(n, -1);
+        state.assign(n, initial);
+        cost.assign(n, 0);
+        mark.assign(n, 0);
+        for (int i = 0; i < precolored; i++) {
+            state[i] = precolored_node;
+            color[i] = i;
+            degree[i] = infinite_degree;
+        }
+    }
+
+    void addEdge(int u, int v) {
+        if (u == v || !adjSet.insert(edgeKey(u, v)).second) return;
+        if (state[u] != precolored_node) {
+            adjList[u].push_back(v);
+            inGraph[u].push_back(v);
+            degree[u]++;
+        }
+        if (state[v] != precolored_node) {
+            adjList[v].push_back(u);
+            inGraph[v].push_back(u);
+            degree[v]++;
+        }
+    }
+
+    void addMove(int dst, int src) {
+        moves.push_back({src, dst});
+        moveState.push_back(worklist_move);
+        moveMark.push_back(0);
+        int m = moves.size() - 1;
+        for (int u: {src, dst}) {
+            moveList[u].push_back(m);
+            liveMoves[u]++;
+            if (src == dst) break;
+        }
+        worklistMoves.insert(m);
+    }
+
+    void addCost(int u, double c) {
+        cost[u] += c;
+    }
+
+    // u takes color c if it is free when u is colored
+    void addHint(int u, int c) {
+        hint[u] = c;
+    }
+
+    void run() {
+        makeWorklist();
+        while (true) {
+            if (!simplifyWorklist.empty()) simplify();
+            else if (!worklistMoves.empty()) coalesce();
+            else if (!freezeWorklist.empty()) freeze();
+            else if (!spillWorklist.empty()) selectSpill();
+            else break;
+        }
+        assignColors();
+    }
+
+    // the registers of the colored variables, and the callee-saved ones among them
+    void result(std::map<std::string, REG>& assigned, std::set<REG>& usedCalleeSaved) const {
+        for (size_t i = 0; i < names.size(); i++) {
+            int c = color[precolored + i];
+            if (c < 0) continue;
+            assigned[names[i]] = regs[c];
+            if (c >= precolored) usedCalleeSaved.insert(regs[c]);
+        }
+    }
+
+private:
+    enum NodeState { precolored_node, initial, simplify_list, freeze_list, spill_list, spilled, coalesced, colored, on_stack };
+    enum MoveState { coalesced_move, constrained_move, frozen_move, worklist_move, active_move };
+    static const int infinite_degree = 1 << 30;
+
+    int precolored, K, n = 0;
+    std::vector<REG> regs;                      // color -> register
+    std::vector<std::string> names;             // node - precolored -> variable
+
+    std::unordered_set<uint64_t> adjSet;        // edgeKey of each edge
+    std::vector<std::vector<int>> adjList;
+    std::vector<std::vector<int>> inGraph;      // adjList without the nodes known to be on the stack or coalesced
+    std::vector<int> degree;
+    std::vector<std::vector<int>> moveList;     // may still hold moves which are done, each move once
+    std::vector<int> liveMoves;                 // the worklist and active moves in moveList, moveRelated if > 0
+    std::vector<int> alias;
+    std::vector<int> color;
+    std::vector<int> hint;
+    std::vector<NodeState> state;
+    std::vector<double> cost;
+
+    std::vector<std::pair<int, int>> moves;     // (src, dst)
+    std::vector<MoveState> moveState;
+    std::set<int> worklistMoves, activeMoves;
+
+    std::set<int> simplifyWorklist, freezeWorklist, spillWorklist;
+    std::vector<int> selectStack;
+
+    // scratch marks of nodes and moves, set to the current stamp
+    std::vector<int> mark, moveMark;
+    int stamp = 0;
+
+    static uint64_t edgeKey(int u, int v) {
+        if (u > v) std::swap(u, v);
+        return (static_cast<uint64_t>(u) << 32) | static_cast<uint32_t>(v);
+    }
+
+    bool interferes(int u, int v) const {
+        return adjSet.count(edgeKey(u, v)) > 0;
+    }
+
+    // f(v) for the neighbours of u which are still in the graph, the others leave inGraph[u] for good
+    template<typename F>
+    void forAdjacent(int u, F f) {
+        auto& list = inGraph[u];
+        list.erase(std::remove_if(list.begin(), list.end(), [&](int v) {
+            return state[v] == on_stack || state[v] == coalesced;
+        }), list.end());
+        for (size_t i = 0; i < list.size(); i++) {
+            int v = list[i];
+            if (state[v] != on_stack && state[v] != coalesced) f(v);
+        }
+    }
+
+    static bool isLive(MoveState s) {
+        return s == worklist_move || s == active_move;
+    }
+
+    // f(m) for the worklist and active moves of u, the others are dropped from its list
+    template<typename F>
+    void forNodeMoves(int u, F f) {
+        auto& list = moveList[u];
+        list.erase(std::remove_if(list.begin(), list.end(), [&](int m) { return !isLive(moveState[m]); }), list.end());
+        for (size_t i = 0; i < list.size(); i++) {
+            if (isLive(moveState[list[i]])) f(list[i]);
+        }
+    }
+
+    bool moveRelated(int u) const {
+        return liveMoves[u] > 0;
+    }
+
+    void moveTo(int u, NodeState s) {
+        switch (state[u]) {
+            case simplify_list: simplifyWorklist.erase(u); break;
+            case freeze_list: freezeWorklist.erase(u); break;
+            case spill_list: spillWorklist.erase(u); break;
+            default: break;
+        }
+        state[u] = s;
+        switch (s) {
+            case simplify_list: simplifyWorklist.insert(u); break;
+            case freeze_list: freezeWorklist.insert(u); break;
+            case spill_list: spillWorklist.insert(u); break;
+            default: break;
+        }
+    }
+
+    // a live move is in the moveList of the alias of each end, once if they are the same
+    void setMoveState(int m, MoveState s) {
+        bool wasLive = isLive(moveState[m]);
+        if (moveState[m] == worklist_move) worklistMoves.erase(m);
+        if (moveState[m] == active_move) activeMoves.erase(m);
+        moveState[m] = s;
+        if (s == worklist_move) worklistMoves.insert(m);
+        if (s == active_move) activeMoves.insert(m);
+        if (wasLive && !isLive(s)) {
+            int x = getAlias(moves[m].first), y = getAlias(moves[m].second);
+            liveMoves[x]--;
+            if (y != x) liveMoves[y]--;
+        }
+    }
+
+    void makeWorklist() {
+        for (int u = precolored; u < n; u++) {
+            if (degree[u] >= K) moveTo(u, spill_list);
+            else if (moveRelated(u)) moveTo(u, freeze_list);
+            else moveTo(u, simplify_list);
+        }
+    }
+
+    void simplify() {
+        int u = *simplifyWorklist.begin();
+        moveTo(u, on_stack);
+        selectStack.push_back(u);
+        forAdjacent(u, [&](int v) { decrementDegree(v); });
+    }
+
+    void decrementDegree(int u) {
+        int d = degree[u]--;
+        if (d != K || state[u] == precolored_node) return;
+        enableMoves(u);
+        forAdjacent(u, [&](int v) { enableMoves(v); });
+        moveTo(u, moveRelated(u) ? freeze_list : simplify_list);
+    }
+
+    void enableMoves(int u) {
+        forNodeMoves(u, [&](int m) {
+            if (moveState[m] == active_move) setMoveState(m, worklist_move);
+        });
+    }
+
+    int getAlias(int u) const {
+        while (state[u] == coalesced) u = alias[u];
+        return u;
+    }
+
+    void addWorkList(int u) {
+        if (state[u] != precolored_node && !moveRelated(u) && degree[u] < K) moveTo(u, simplify_list);
+    }
+
+    // George: every neighbour t of v is insignificant or already interferes with r
+    bool georgeOK(int t, int r) const {
+        return degree[t] < K || state[t] == precolored_node || interferes(t, r);
+    }
+
+    // Briggs: the merged node has less than K neighbours of significant degree
+    bool briggsOK(int u, int v) {
+        stamp++;
+        int k = 0;
+        auto count = [&](int t) {
+            if (mark[t] == stamp) return;
+            mark[t] = stamp;
+            if (degree[t] >= K) k++;
+        };
+        forAdjacent(u, count);
+        forAdjacent(v, count);
+        return k < K;
+    }
+
+    void coalesce() {
+        int m = *worklistMoves.begin();
+        int x = getAlias(moves[m].first), y = getAlias(moves[m].second);
+        int u = x, v = y;
+        // the smaller node merges into the larger one, a variable copied into many temporaries keeps its edges
+        if (state[y] == precolored_node || (state[x] != precolored_node && adjList[y].size() > adjList[x].size())) std::swap(u, v);
+        if (u == v) {
+            setMoveState(m, coalesced_move);
+            addWorkList(u);
+        }
+        else if (state[v] == precolored_node || interferes(u, v)) {
+            setMoveState(m, constrained_move);
+            addWorkList(u);
+            addWorkList(v);
+        }
+        // George only scans the neighbours of v, the smaller node, Briggs also those of u
+        else if (allGeorgeOK(u, v) || (state[u] != precolored_node && briggsOK(u, v))) {
+            setMoveState(m, coalesced_move);
+            combine(u, v);
+            addWorkList(u);
+        }
+        else {
+            setMoveState(m, active_move);
+        }
+    }
+
+    bool allGeorgeOK(int u, int v) {
+        bool ok = true;
+        forAdjacent(v, [&](int t) { ok = ok && georgeOK(t, u); });
+        return ok;
+    }
+
+    void combine(int u, int v) {
+        moveTo(v, coalesced);
+        alias[v] = u;
+        enableMoves(v);
+        // the live moves of v which u does not have yet
+        stamp++;
+        for (auto m: moveList[u]) moveMark[m] = stamp;
+        for (auto m: moveList[v]) {
+            if (!isLive(moveState[m]) || moveMark[m] == stamp) continue;
+            moveList[u].push_back(m);
+            liveMoves[u]++;
+        }
+        moveList[v].clear();
+        cost[u] += cost[v];
+        forAdjacent(v, [&](int t) {
+            addEdge(t, u);
+            decrementDegree(t);
+        });
+        if (degree[u] >= K && state[u] == freeze_list) moveTo(u, spill_list);
+    }
+
+    void freeze() {
+        int u = *freezeWorklist.begin();
+        moveTo(u, simplify_list);
+        freezeMoves(u);
+    }
+
+    void freezeMoves(int u) {
+        forNodeMoves(u, [&](int m) {
+            int x = moves[m].first, y = moves[m].second;
+            int v = getAlias(y) == getAlias(u) ? getAlias(x) : getAlias(y);
+            setMoveState(m, frozen_move);
+            if (state[v] == freeze_list && !moveRelated(v)) moveTo(v, simplify_list);
+        });
+    }
+
+    // the cheapest variable to keep in memory, per interference it resolves
+    void selectSpill() {
+        int best = -1;
+        double bestCost = 0;
+        for (auto u: spillWorklist) {
+            double c = cost[u] / std::max(degree[u], 1);
+            if (best < 0 || c < bestCost) {
+                best = u;
+                bestCost = c;
+            }
+        }
+        moveTo(best, simplify_list);
+        freezeMoves(best);
+    }
+
+    void assignColors() {
+        std::vector<bool> used(K, false);       // callee-saved colors already handed out
+        while (!selectStack.empty()) {
+            int u = selectStack.back();
+            selectStack.pop_back();
+            std::vector<bool> ok(K, true);
+            for (auto w: adjList[u]) {
+                int a = getAlias(w);
+                if (state[a] == colored || state[a] == precolored_node) ok[color[a]] = false;
+            }
+            // the hinted one, a caller-saved register, then a callee-saved one which is already saved
+            int c = hint[u] >= 0 && ok[hint[u]] ? hint[u] : -1;
+            for (int i = 0; i < precolored && c < 0; i++) {
+                if (ok[i]) c = i;
+            }
+            for (int i = precolored; i < K && c < 0; i++) {
+                if (ok[i] && used[i]) c = i;
+            }
+            for (int i = precolored; i < K && c < 0; i++) {
+                if (ok[i]) c = i;
+            }
+            if (c < 0) {
+                state[u] = spilled;
+                continue;
+            }
+            state[u] = colored;
+            color[u] = c;
+            used[c] = true;
+        }
+        for (int u = precolored; u < n; u++) {
+            if (state[u] == coalesced) color[u] = color[getAlias(u)];
+        }
+    }
+};
+
+template<typename REG>
+void colorClass(const ir::Function& func, const backend::FunctionLiveness& live, bool isFloat,
+    const std::vector<REG>& callerSaved, const std::vector<REG>& calleeSaved, const std::map<std::string, REG>& hints,
+    std::map<std::string, REG>& assigned, std::vector<REG>& usedCalleeSaved) {
+    GraphColoring<REG> graph(callerSaved, calleeSaved);
+    std::map<std::string, int> node;
+    for (const auto& c: live.candidates) {
+        if (c.second == isFloat) node[c.first] = graph.addNode(c.first);
+    }
+    graph.finishNodes();
+    for (const auto& it: hints) {
+        auto r = std::find(callerSaved.begin(), callerSaved.end(), it.second);
+        if (node.count(it.first) && r != callerSaved.end()) graph.addHint(node[it.first], r - callerSaved.begin());
+    }
+    auto nodeOf = [&](const ir::Operand& op) {
+        auto it = node.find(op.name);
+        return opt::is_var(op) && it != node.end() ? it->second : -1;
+    };
+
+    // the parameters are all defined at the entry
+    std::vector<int> entry;
+    for (const auto& name: live.liveAtEntry) {
+        if (node.count(name)) entry.push_back(node[name]);
+    }
+    for (size_t i = 0; i < entry.size(); i++) {
+        for (size_t j = 0; j < i; j++) graph.addEdge(entry[i], entry[j]);
+    }
+
+    for (size_t pc = 0; pc < func.InstVec.size(); pc++) {
+        auto inst = func.InstVec[pc];
+        auto def = opt::def_of(inst);
+        int d = def ? nodeOf(*def) : -1;
+        double weight = std::pow(10.0, std::min(live.loopDepth[pc], 8));
+        for (const auto& use: opt::uses_of(inst)) {
+            int u = nodeOf(use);
+            if (u >= 0) graph.addCost(u, weight);
+        }
+        if (d >= 0) graph.addCost(d, weight);
+
+        // a copy does not make its source and destination interfere
+        bool isMove = inst->op == ir::Operator::def || inst->op == ir::Operator::mov
+                   || inst->op == ir::Operator::fdef || inst->op == ir::Operator::fmov;
+        int src = isMove ? nodeOf(inst->op1) : -1;
+        if (d >= 0 && src >= 0) graph.addMove(d, src);
+        for (const auto& name: live.liveAfter[pc]) {
+            auto it = node.find(name);
+            if (it == node.end()) continue;
+            if (d >= 0 && it->second != src) graph.addEdge(d, it->second);
+            // a value live across a call can not be in a caller-saved register
+            if (inst->op == ir::Operator::call && it->second != d) {
+                for (int p = 0; p < static_cast<int>(callerSaved.size()); p++) graph.addEdge(it->second, p);
+            }
+        }
+    }
+
+    graph.run();
+    std::set<REG> callee;
+    graph.result(assigned, callee);
+    usedCalleeSaved.assign(callee.begin(), callee.end());
+}
+
+} // namespace
+
+backend::RegAssignment backend::graphColoring(const ir::Function& func, const std::set<std::string>& globals, bool leaf) {
+    FunctionLiveness live(func, globals);
+    // the edges grow with the variables live at the same pc, a huge graph is left to linear scan
+    size_t livePairs = 0;
+    for (const auto& after: live.liveAfter) livePairs += after.size();
+    if (live.candidates.size() > maxGraphNodes || livePairs > maxGraphLivePairs) return linearScanOf(func, live, leaf);
+    RegAssignment res;
+    colorClass(func, live, false, intCallerSaved(leaf), calleeSavedRegs, paramHints(func, leaf), res.reg, res.usedCalleeSaved);
+    colorClass(func, live, true, callerSavedFRegs, calleeSavedFRegs, {}, res.freg, res.usedCalleeSavedF);
+    return res;
+}
+
+backend::RegAssignment backend::allocateRegisters(RegAllocator allocator, const ir::Function& func, const std::set<std::string>& globals, bool leaf) {
+    switch (allocator) {
+        case RegAllocator::linear: return linearScan(func, globals, leaf);
+        case RegAllocator::graph: return graphColoring(func, globals, leaf);
+        default: return RegAssignment();
+    }
+}
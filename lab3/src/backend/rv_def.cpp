@@ -110,10 +110,39 @@ std::string toString(rvOPCODE op) {
         case rvOPCODE::BGEU: return "bgeu";
         case rvOPCODE::JAL:  return "jal";
         case rvOPCODE::JALR: return "jalr";
+        case rvOPCODE::LUI:  return "lui";
+        case rvOPCODE::MUL:  return "mul";
+        case rvOPCODE::MULH: return "mulh";
+        case rvOPCODE::MULHSU: return "mulhsu";
+        case rvOPCODE::MULHU:return "mulhu";
+        case rvOPCODE::DIV:  return "div";
+        case rvOPCODE::DIVU: return "divu";
+        case rvOPCODE::REM:  return "rem";
+        case rvOPCODE::REMU: return "remu";
+        case rvOPCODE::FLW:  return "flw";
+        case rvOPCODE::FSW:  return "fsw";
+        case rvOPCODE::FADD_S: return "fadd.s";
+        case rvOPCODE::FSUB_S: return "fsub.s";
+        case rvOPCODE::FMUL_S: return "fmul.s";
+        case rvOPCODE::FDIV_S: return "fdiv.s";
+        case rvOPCODE::FEQ_S:  return "feq.s";
+        case rvOPCODE::FLT_S:  return "flt.s";
+        case rvOPCODE::FLE_S:  return "fle.s";
+        case rvOPCODE::FCVT_S_W: return "fcvt.s.w";
+        case rvOPCODE::FCVT_W_S: return "fcvt.w.s";
+        case rvOPCODE::FMV_X_W:  return "fmv.x.w";
+        case rvOPCODE::FMV_W_X:  return "fmv.w.x";
         case rvOPCODE::LA:   return "la";
         case rvOPCODE::LI:   return "li";
         case rvOPCODE::MOV:  return "mv";
         case rvOPCODE::J:    return "j";
+        case rvOPCODE::JR:   return "jr";
+        case rvOPCODE::SEQZ: return "seqz";
+        case rvOPCODE::SNEZ: return "snez";
+        case rvOPCODE::BEQZ: return "beqz";
+        case rvOPCODE::BNEZ: return "bnez";
+        case rvOPCODE::FMV_S:return "fmv.s";
+        case rvOPCODE::LABEL:return "";
         default: throw std::runtime_error("Unknown rvOPCODE");
     }
 }
@@ -6,42 +6,204 @@ namespace rv {
 
 std::string rv_inst::draw() const {
     std::ostringstream oss;
+    if (op == rvOPCODE::LABEL) return label + ":";
     oss << toString(op) << " ";
     switch (op) {
         case rvOPCODE::ADD: case rvOPCODE::SUB: case rvOPCODE::SLT: case rvOPCODE::SLTU:
         case rvOPCODE::SLL: case rvOPCODE::SRL: case rvOPCODE::SRA:
         case rvOPCODE::AND: case rvOPCODE::OR:  case rvOPCODE::XOR:
+        case rvOPCODE::MUL: case rvOPCODE::MULH: case rvOPCODE::MULHSU: case rvOPCODE::MULHU:
+        case rvOPCODE::DIV: case rvOPCODE::DIVU: case rvOPCODE::REM: case rvOPCODE::REMU:
             oss << toString(rd) << ", " << toString(rs1) << ", " << toString(rs2);
             break;
         case rvOPCODE::ADDI: case rvOPCODE::SLTI: case rvOPCODE::SLTIU:
         case rvOPCODE::SLLI: case rvOPCODE::SRLI: case rvOPCODE::SRAI:
         case rvOPCODE::XORI: case rvOPCODE::ORI: case rvOPCODE::ANDI:
-        case rvOPCODE::LW:
             oss << toString(rd) << ", " << toString(rs1) << ", " << imm;
             break;
+        case rvOPCODE::LW:
+            if (!label.empty()) oss << toString(rd) << ", " << label;
+            else oss << toString(rd) << ", " << imm << "(" << toString(rs1) << ")";
+            break;
         case rvOPCODE::SW:
             oss << toString(rs2) << ", " << imm << "(" << toString(rs1) << ")";
             break;
-        case rvOPCODE::JAL: case rvOPCODE::JALR:
+        case rvOPCODE::FLW:
+            oss << toString(frd) << ", " << imm << "(" << toString(rs1) << ")";
+            break;
+        case rvOPCODE::FSW:
+            oss << toString(frs2) << ", " << imm << "(" << toString(rs1) << ")";
+            break;
+        case rvOPCODE::JAL:
             oss << toString(rd) << ", " << label;
             break;
+        case rvOPCODE::JALR:
+            oss << toString(rd) << ", " << imm << "(" << toString(rs1) << ")";
+            break;
         case rvOPCODE::BEQ: case rvOPCODE::BNE: case rvOPCODE::BLT: case rvOPCODE::BGE:
         case rvOPCODE::BLTU: case rvOPCODE::BGEU:
             oss << toString(rs1) << ", " << toString(rs2) << ", " << label;
             break;
-        case rvOPCODE::LA: case rvOPCODE::LI:
+        case rvOPCODE::BEQZ: case rvOPCODE::BNEZ:
+            oss << toString(rs1) << ", " << label;
+            break;
+        case rvOPCODE::LA:
             oss << toString(rd) << ", " << label;
             break;
-        case rvOPCODE::MOV:
+        case rvOPCODE::LI: case rvOPCODE::LUI:
+            oss << toString(rd) << ", " << imm;
+            break;
+        case rvOPCODE::MOV: case rvOPCODE::SEQZ: case rvOPCODE::SNEZ:
             oss << toString(rd) << ", " << toString(rs1);
             break;
         case rvOPCODE::J:
             oss << label;
             break;
+        case rvOPCODE::JR:
+            oss << toString(rs1);
+            break;
+        case rvOPCODE::FADD_S: case rvOPCODE::FSUB_S: case rvOPCODE::FMUL_S: case rvOPCODE::FDIV_S:
+            oss << toString(frd) << ", " << toString(frs1) << ", " << toString(frs2);
+            break;
+        case rvOPCODE::FEQ_S: case rvOPCODE::FLT_S: case rvOPCODE::FLE_S:
+            oss << toString(rd) << ", " << toString(frs1) << ", " << toString(frs2);
+            break;
+        case rvOPCODE::FMV_S:
+            oss << toString(frd) << ", " << toString(frs1);
+            break;
+        case rvOPCODE::FCVT_S_W: case rvOPCODE::FMV_W_X:
+            oss << toString(frd) << ", " << toString(rs1);
+            break;
+        case rvOPCODE::FCVT_W_S:
+            // the C conversion truncates
+            oss << toString(rd) << ", " << toString(frs1) << ", rtz";
+            break;
+        case rvOPCODE::FMV_X_W:
+            oss << toString(rd) << ", " << toString(frs1);
+            break;
         default:
             oss << "";
     }
     return oss.str();
 }
 
+rv_inst inst(rvOPCODE op, rvREG rd, rvREG rs1, rvREG rs2) {
+    rv_inst res;
+    res.op = op;
+    res.rd = rd;
+    res.rs1 = rs1;
+    res.rs2 = rs2;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvREG rd, rvREG rs1, int32_t imm) {
+    rv_inst res;
+    res.op = op;
+    if (op == rvOPCODE::SW) res.rs2 = rd;
+    else res.rd = rd;
+    res.rs1 = rs1;
+    res.imm = imm;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvREG rd, rvREG rs1) {
+    rv_inst res;
+    res.op = op;
+    res.rd = rd;
+    res.rs1 = rs1;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvREG rd, int32_t imm) {
+    rv_inst res;
+    res.op = op;
+    res.rd = rd;
+    res.imm = imm;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvREG rd, const std::string& label) {
+    rv_inst res;
+    res.op = op;
+    if (op == rvOPCODE::BEQZ || op == rvOPCODE::BNEZ) res.rs1 = rd;
+    else res.rd = rd;
+    res.label = label;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvREG rs1, rvREG rs2, const std::string& label) {
+    rv_inst res;
+    res.op = op;
+    res.rs1 = rs1;
+    res.rs2 = rs2;
+    res.label = label;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvREG rs1) {
+    rv_inst res;
+    res.op = op;
+    res.rs1 = rs1;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, const std::string& label) {
+    rv_inst res;
+    res.op = op;
+    res.label = label;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvFREG rd, rvFREG rs1, rvFREG rs2) {
+    rv_inst res;
+    res.op = op;
+    res.frd = rd;
+    res.frs1 = rs1;
+    res.frs2 = rs2;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvREG rd, rvFREG rs1, rvFREG rs2) {
+    rv_inst res;
+    res.op = op;
+    res.rd = rd;
+    res.frs1 = rs1;
+    res.frs2 = rs2;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvFREG rd, rvFREG rs1) {
+    rv_inst res;
+    res.op = op;
+    res.frd = rd;
+    res.frs1 = rs1;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvFREG rd, rvREG rs1) {
+    rv_inst res;
+    res.op = op;
+    res.frd = rd;
+    res.rs1 = rs1;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvREG rd, rvFREG rs1) {
+    rv_inst res;
+    res.op = op;
+    res.rd = rd;
+    res.frs1 = rs1;
+    return res;
+}
+
+rv_inst inst(rvOPCODE op, rvFREG rd, rvREG rs1, int32_t imm) {
+    rv_inst res;
+    res.op = op;
+    if (op == rvOPCODE::FSW) res.frs2 = rd;
+    else res.frd = rd;
+    res.rs1 = rs1;
+    res.imm = imm;
+    return res;
+}
+
 } // namespace rv
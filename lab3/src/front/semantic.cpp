@@ -20,6 +20,14 @@ namespace frontend {
     map<std::string, int> constValues;
 }
 
+// 数组初始化前已整体清零，值为 0 的初始化元素不需要 store
+template<typename T>
+static bool is_zero_init(const T* exp) {
+    if(exp->t == Type::IntLiteral || exp->t == Type::Int) return exp->is_computable && exp->value == 0;
+    if(exp->t == Type::FloatLiteral) return std::stof(exp->v) == 0 && exp->v.find('-') == string::npos;
+    return false;
+}
+
 map<std::string,ir::Function*>* frontend::get_lib_funcs() {
     static map<std::string,ir::Function*> lib_funcs = {
         {"getint", new Function("getint", Type::Int)},
@@ -242,6 +250,15 @@ void frontend::Analyzer::analyzeConstDef(ConstDef* root, vector<ir::Instruction*
     else{
         assert(0 && "ConstDef error: unsupported type");
     }
+    // 局部数组先整体清零，初始化时只 store 非零元素
+    if(size > 0 && symbol_table.scope_stack.size() > 1){
+        buffer.push_back(new Instruction(
+            Operand(root->n, t == Type::Int ? Type::IntPtr : Type::FloatPtr), // op1: 数组名
+            Operand(std::to_string(size), Type::IntLiteral), // op2: 元素个数
+            Operand(), // des: 无
+            Operator::memset
+        ));
+    }
     // 分析ConstInitVal
     analyzeConstInitVal(constInitVal, buffer, size, 0, dims);
 }
@@ -257,13 +274,15 @@ void frontend::Analyzer::analyzeConstInitVal(ConstInitVal* root, vector<ir::Inst
         // 生成IR：store 常量到数组/变量
         // 如果是数组元素，name[offset] = constExp->v
         if (size > 0) {
-            // 数组元素初始化
-            buffer.push_back(new Instruction(
-                Operand(name, root->t), // op1: 数组名
-                Operand(std::to_string(offset), Type::IntLiteral), // op2: 偏移
-                Operand(constExp->v, constExp->t), // des: 常量值
-                Operator::store
-            ));
+            // 数组元素初始化，数组已经是零，跳过值为 0 的元素
+            if (!is_zero_init(constExp)) {
+                buffer.push_back(new Instruction(
+                    Operand(name, root->t), // op1: 数组名
+                    Operand(std::to_string(offset), Type::IntLiteral), // op2: 偏移
+                    Operand(constExp->v, constExp->t), // des: 常量值
+                    Operator::store
+                ));
+            }
         }
         else {
             // 普通变量初始化
@@ -321,32 +340,25 @@ void frontend::Analyzer::analyzeConstInitVal(ConstInitVal* root, vector<ir::Inst
     }
     else {
         // '{' [ ConstInitVal { ',' ConstInitVal } ] '}'
-        // 根据测试点，多维数组的初始化不使用多层花括号嵌套，偷个懒先
-        int idx = 1; // 跳过 '{'
-        int elem = 0;
-        // 统计本层已初始化元素数
-        while (idx < root->children.size() - 1) { // 跳过 '}'
-            if (MATCH_CHILD_TYPE(CONSTINITVAL, idx)) {
-                GET_CHILD_PTR(subInit, ConstInitVal, idx);
-                subInit->v = root->v;
-                subInit->t = root->t; // 传递数组原名(下一层会重新加后缀)和类型
-                analyzeConstInitVal(subInit, buffer, size, offset + elem, dims);
-                elem++;
+        // 数组已经是零(局部数组被 memset 清零，全局数组的存储本身为零)，不需要补零
+        // 嵌套的花括号初始化下一维的一个子数组，它从下一个子数组的边界开始
+        int sub_size = dims.empty() ? size : size / dims[0];
+        vector<int> sub_dims(dims.begin() + (dims.empty() ? 0 : 1), dims.end());
+        int pos = 0; // 本层已初始化到的元素位置
+        for (size_t idx = 1; idx + 1 < root->children.size(); idx += 2) { // 跳过 '{' '}' ','
+            if (!(MATCH_CHILD_TYPE(CONSTINITVAL, idx))) continue;
+            GET_CHILD_PTR(subInit, ConstInitVal, idx);
+            subInit->v = root->v;
+            subInit->t = root->t; // 传递数组原名(下一层会重新加后缀)和类型
+            if (subInit->children.size() == 1 && subInit->children[0]->type == NodeType::CONSTEXP) {
+                analyzeConstInitVal(subInit, buffer, size, offset + pos, dims);
+                pos++;
+            }
+            else {
+                if (pos % sub_size) pos += sub_size - pos % sub_size;
+                analyzeConstInitVal(subInit, buffer, sub_size, offset + pos, sub_dims);
+                pos += sub_size;
             }
-            idx += 2; // 跳过 ','
-        }
-
-        // 从lab3来看似乎全局变量手动补零是错的，他会自动补
-        if(symbol_table.scope_stack.size() == 1) return;
-        
-        // 补零
-        for (; elem < size; ++elem) {
-            buffer.push_back(new Instruction(
-                Operand(name, root->t), // op1: 数组名
-                Operand(std::to_string(offset + elem), Type::IntLiteral), // op2: 偏移
-                Operand("0", Type::IntLiteral), // des: 常量值
-                Operator::store
-            ));
         }
     }
 }
@@ -420,6 +432,15 @@ void frontend::Analyzer::analyzeVarDef(VarDef* root, vector<ir::Instruction*>& b
         else{
             assert(0 && "VarDef error: unsupported type");
         }
+        // 局部数组先整体清零，初始化时只 store 非零元素
+        if(size > 0 && symbol_table.scope_stack.size() > 1){
+            buffer.push_back(new Instruction(
+                Operand(root->n, t == Type::Int ? Type::IntPtr : Type::FloatPtr), // op1: 数组名
+                Operand(std::to_string(size), Type::IntLiteral), // op2: 元素个数
+                Operand(), // des: 无
+                Operator::memset
+            ));
+        }
         // 分析InitVal
         analyzeInitVal(initVal, buffer, size, 0, dims);
     }
@@ -462,13 +483,15 @@ void frontend::Analyzer::analyzeInitVal(InitVal* root, vector<ir::Instruction*>&
         // 生成IR：store 常量到数组/变量
         // 如果是数组元素，name[offset] = exp->v
         if (size > 0) {
-            // 数组元素初始化
-            buffer.push_back(new Instruction(
-                Operand(name, root->t), // op1: 数组名
-                Operand(std::to_string(offset), Type::IntLiteral), // op2: 偏移
-                Operand(exp->v, exp->t), // des: 常量值
-                Operator::store
-            ));
+            // 数组元素初始化，数组已经是零，跳过值为 0 的元素
+            if (!is_zero_init(exp)) {
+                buffer.push_back(new Instruction(
+                    Operand(name, root->t), // op1: 数组名
+                    Operand(std::to_string(offset), Type::IntLiteral), // op2: 偏移
+                    Operand(exp->v, exp->t), // des: 常量值
+                    Operator::store
+                ));
+            }
         }
         else {
             // 普通变量初始化
@@ -522,28 +545,25 @@ void frontend::Analyzer::analyzeInitVal(InitVal* root, vector<ir::Instruction*>&
     }
     else {
         // '{' [ InitVal { ',' InitVal } ] '}'
-        // 根据测试点，多维数组的初始化不使用多层花括号嵌套，偷个懒先
-        int idx = 1; // 跳过 '{'
-        int elem = 0;
-        // 统计本层已初始化元素数
-        while (idx < root->children.size() - 1) { // 跳过 '}'
-            if (MATCH_CHILD_TYPE(INITVAL, idx)) {
-                GET_CHILD_PTR(subInit, InitVal, idx);
-                subInit->v = root->v;
-                subInit->t = root->t; // 传递数组原名(下一层会重新加后缀)和类型
-                analyzeInitVal(subInit, buffer, size, offset + elem, dims);
-                elem++;
+        // 数组已经是零(局部数组被 memset 清零，全局数组的存储本身为零)，不需要补零
+        // 嵌套的花括号初始化下一维的一个子数组，它从下一个子数组的边界开始
+        int sub_size = dims.empty() ? size : size / dims[0];
+        vector<int> sub_dims(dims.begin() + (dims.empty() ? 0 : 1), dims.end());
+        int pos = 0; // 本层已初始化到的元素位置
+        for (size_t idx = 1; idx + 1 < root->children.size(); idx += 2) { // 跳过 '{' '}' ','
+            if (!(MATCH_CHILD_TYPE(INITVAL, idx))) continue;
+            GET_CHILD_PTR(subInit, InitVal, idx);
+            subInit->v = root->v;
+            subInit->t = root->t; // 传递数组原名(下一层会重新加后缀)和类型
+            if (subInit->children.size() == 1 && subInit->children[0]->type == NodeType::EXP) {
+                analyzeInitVal(subInit, buffer, size, offset + pos, dims);
+                pos++;
+            }
+            else {
+                if (pos % sub_size) pos += sub_size - pos % sub_size;
+                analyzeInitVal(subInit, buffer, sub_size, offset + pos, sub_dims);
+                pos += sub_size;
             }
-            idx += 2; // 跳过 ','
-        }
-        // 补零
-        for (; elem < size; ++elem) {
-            buffer.push_back(new Instruction(
-                Operand(name, root->t), // op1: 数组名
-                Operand(std::to_string(offset + elem), Type::IntLiteral), // op2: 偏移
-                Operand("0", Type::IntLiteral), // des: 常量值
-                Operator::store
-            ));
         }
     }
 }
@@ -35,6 +35,8 @@ std::string ir::Instruction::draw() const {
         }
         case ir::Operator::alloc:
             return "alloc " + this->des.name + ", " + this->op1.name;
+        case ir::Operator::memset:
+            return "memset " + this->op1.name + ", " + this->op2.name;
         case ir::Operator::mov:
             return "mov " + this->des.name + ", " + this->op1.name;
         case ir::Operator::fmov:
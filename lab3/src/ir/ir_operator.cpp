@@ -14,6 +14,7 @@ std::string toString(Operator t)
         case Operator::alloc: return "alloc";
         case Operator::store: return "store";
         case Operator::getptr: return "getptr";
+        case Operator::memset: return "memset";
         case Operator::load: return "load";
         case Operator::def: return "def";
         case Operator::fdef: return "fdef";
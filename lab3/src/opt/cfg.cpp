@@ -0,0 +1,199 @@
+#include "opt/cfg.h"
+#include "opt/ir_util.h"
+
+#include<map>
+#include<set>
+#include<cassert>
+#include<algorithm>
+
+using ir::Operator;
+
+ir::Instruction* opt::BasicBlock::terminator() const {
+    if (insts.empty()) return nullptr;
+    auto last = insts.back();
+    return (last->op == Operator::_goto || last->op == Operator::_return) ? last : nullptr;
+}
+
+std::vector<opt::BasicBlock*> opt::BasicBlock::succs() const {
+    std::vector<BasicBlock*> res;
+    if (jump_target) res.push_back(jump_target);
+    if (fall_through && fall_through != jump_target) res.push_back(fall_through);
+    return res;
+}
+
+opt::CFG::CFG(ir::Function* f): func(f) {
+    const auto& insts = func->InstVec;
+    int n = insts.size();
+
+    // find leaders, a jump target equals to n means jumping to the end of function
+    std::set<int> leaders = {0};
+    for (int i = 0; i < n; i++) {
+        if (insts[i]->op == Operator::_goto) {
+            int target = i + goto_offset(insts[i]);
+            assert(target >= 0 && target <= n && "goto out of function");
+            leaders.insert(target);
+            leaders.insert(i + 1);
+        }
+        else if (insts[i]->op == Operator::_return) {
+            leaders.insert(i + 1);
+        }
+    }
+    bool need_sentinel = leaders.count(n) && n > 0;
+    leaders.erase(n);
+
+    std::map<int, BasicBlock*> block_at;
+    std::vector<int> starts(leaders.begin(), leaders.end());
+    for (size_t k = 0; k < starts.size(); k++) {
+        auto bb = new BasicBlock();
+        int end = k + 1 < starts.size() ? starts[k + 1] : n;
+        bb->insts.assign(insts.begin() + starts[k], insts.begin() + end);
+        block_at[starts[k]] = bb;
+        blocks.push_back(bb);
+    }
+    if (need_sentinel || blocks.empty()) {
+        block_at[n] = new BasicBlock();
+        blocks.push_back(block_at[n]);
+    }
+
+    // wire edges
+    for (size_t k = 0; k < blocks.size(); k++) {
+        auto bb = blocks[k];
+        auto next = k + 1 < blocks.size() ? blocks[k + 1] : nullptr;
+        auto term = bb->terminator();
+        if (!term) {
+            bb->fall_through = next;
+            continue;
+        }
+        if (term->op == Operator::_goto) {
+            int pc = starts[k] + bb->insts.size() - 1;
+            bb->jump_target = block_at.at(pc + goto_offset(term));
+            if (is_var(term->op1)) bb->fall_through = next;
+        }
+    }
+    update();
+}
+
+opt::CFG::~CFG() {
+    for (auto bb: blocks) delete bb;
+}
+
+opt::BasicBlock* opt::CFG::insert_block_before(BasicBlock* pos) {
+    auto bb = new BasicBlock();
+    blocks.insert(std::find(blocks.begin(), blocks.end(), pos), bb);
+    return bb;
+}
+
+void opt::CFG::update() {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i]->index = i;
+        blocks[i]->preds.clear();
+    }
+    for (auto bb: blocks) {
+        for (auto succ: bb->succs()) succ->preds.push_back(bb);
+    }
+}
+
+std::vector<opt::BasicBlock*> opt::CFG::reverse_post_order() const {
+    std::vector<BasicBlock*> order;
+    if (blocks.empty()) return order;
+    std::vector<bool> visited(blocks.size(), false);
+    // iterative dfs, stack of (block, next successor to visit)
+    std::vector<std::pair<BasicBlock*, size_t>> stk = {{blocks[0], 0}};
+    visited[0] = true;
+    while (stk.size()) {
+        auto& top = stk.back();
+        auto succs = top.first->succs();
+        if (top.second < succs.size()) {
+            auto succ = succs[top.second++];
+            if (!visited[succ->index]) {
+                visited[succ->index] = true;
+                stk.push_back({succ, 0});
+            }
+        }
+        else {
+            order.push_back(top.first);
+            stk.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+void opt::CFG::linearize() {
+    update();
+    size_t n = blocks.size();
+    std::vector<bool> need_jump(n);
+    std::vector<int> start(n);
+    int pc = 0;
+    for (size_t i = 0; i < n; i++) {
+        auto ft = blocks[i]->fall_through;
+        need_jump[i] = ft && (i + 1 == n || blocks[i + 1] != ft);
+        start[i] = pc;
+        pc += blocks[i]->insts.size() + need_jump[i];
+    }
+
+    std::vector<ir::Instruction*> res;
+    res.reserve(pc);
+    for (size_t i = 0; i < n; i++) {
+        auto bb = blocks[i];
+        for (auto inst: bb->insts) {
+            if (inst->op == Operator::_goto) {
+                assert(inst == bb->insts.back() && bb->jump_target);
+                int off = start[bb->jump_target->index] - (int)res.size();
+                inst->des = ir::Operand(std::to_string(off), ir::Type::IntLiteral);
+            }
+            res.push_back(inst);
+        }
+        if (need_jump[i]) {
+            int off = start[bb->fall_through->index] - (int)res.size();
+            res.push_back(new ir::Instruction(ir::Operand("null", ir::Type::null), ir::Operand(), 
+                                              ir::Operand(std::to_string(off), ir::Type::IntLiteral), Operator::_goto));
+        }
+    }
+    func->InstVec = res;
+}
+
+opt::DomTree::DomTree(const CFG& cfg): idom(cfg.blocks.size(), nullptr), reachable(cfg.blocks.size(), false) {
+    auto rpo = cfg.reverse_post_order();
+    if (rpo.empty()) return;
+    std::vector<int> rpo_num(cfg.blocks.size(), -1);
+    for (size_t i = 0; i < rpo.size(); i++) {
+        rpo_num[rpo[i]->index] = i;
+        reachable[rpo[i]->index] = true;
+    }
+
+    auto entry = rpo[0];
+    idom[entry->index] = entry;
+    auto intersect = [&](BasicBlock* a, BasicBlock* b) {
+        while (a != b) {
+            while (rpo_num[a->index] > rpo_num[b->index]) a = idom[a->index];
+            while (rpo_num[b->index] > rpo_num[a->index]) b = idom[b->index];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < rpo.size(); i++) {
+            auto bb = rpo[i];
+            BasicBlock* new_idom = nullptr;
+            for (auto pred: bb->preds) {
+                if (!idom[pred->index]) continue;
+                new_idom = new_idom ? intersect(pred, new_idom) : pred;
+            }
+            if (new_idom != idom[bb->index]) {
+                idom[bb->index] = new_idom;
+                changed = true;
+            }
+        }
+    }
+    idom[entry->index] = nullptr;
+}
+
+bool opt::DomTree::dominates(const BasicBlock* a, const BasicBlock* b) const {
+    if (!reachable[b->index]) return false;
+    for (auto p = b; p; p = idom[p->index]) {
+        if (p == a) return true;
+    }
+    return false;
+}
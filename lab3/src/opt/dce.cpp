@@ -0,0 +1,56 @@
+#include "opt/dce.h"
+#include "opt/ir_util.h"
+#include "opt/cfg.h"
+#include "opt/liveness.h"
+
+using ir::Operator;
+
+namespace {
+
+bool is_removable(const ir::Instruction* inst) {
+    switch (inst->op) {
+        case Operator::_return: case Operator::_goto: case Operator::call: case Operator::store: case Operator::memset:
+        case Operator::__unuse__:
+            return false;
+        default:
+            return true;
+    }
+}
+
+} // namespace
+
+int opt::dce(ir::Function& func, const std::set<std::string>& globals) {
+    int total = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        CFG cfg(&func);
+        Liveness live(cfg, globals);
+        for (auto bb: cfg.blocks) {
+            auto cur = live.live_out[bb->index];
+            std::vector<ir::Instruction*> kept;
+            for (auto it = bb->insts.rbegin(); it != bb->insts.rend(); ++it) {
+                auto def = def_of(*it);
+                if (is_removable(*it) && def && !cur.count(def->name) && !globals.count(def->name)) {
+                    changed = true;
+                    total++;
+                    continue;
+                }
+                Liveness::step(*it, cur, globals);
+                kept.push_back(*it);
+            }
+            bb->insts.assign(kept.rbegin(), kept.rend());
+        }
+        if (changed) cfg.linearize();
+    }
+    return total;
+}
+
+int opt::dce(ir::Program& program) {
+    auto globals = global_names(program);
+    int total = 0;
+    for (auto& func: program.functions) {
+        total += dce(func, globals);
+    }
+    return total;
+}
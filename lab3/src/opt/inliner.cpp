@@ -0,0 +1,322 @@
+#include "opt/inliner.h"
+#include "opt/ir_util.h"
+
+#include<map>
+#include<set>
+#include<string>
+#include<vector>
+#include<cassert>
+
+using ir::Operator;
+using ir::Type;
+
+namespace {
+
+// a single-call-site callee is moved into its caller unless it is larger than this many times the threshold
+const int single_site_factor = 8;
+// stop inlining into a function once it has grown to this many instructions
+const int max_caller_size = 2000;
+// the backend sizes every frame exactly, this only keeps inlining from growing a frame past 256 KiB of stack
+const int max_frame_words = 1 << 16;
+
+const ir::Function* find_function(const ir::Program& program, const std::string& name) {
+    for (const auto& f: program.functions) {
+        if (f.name == name) return &f;
+    }
+    return nullptr;
+}
+
+std::set<std::string> callees_of(const ir::Function& func) {
+    std::set<std::string> res;
+    for (auto inst: func.InstVec) {
+        if (inst->op == Operator::call && !opt::is_lib_call(inst)) res.insert(inst->op1.name);
+    }
+    return res;
+}
+
+int size_of(const ir::Function& func) {
+    int size = 0;
+    for (auto inst: func.InstVec) {
+        if (inst->op != Operator::__unuse__) size++;
+    }
+    return size;
+}
+
+/**
+ * words of stack used by the locals, temporaries and arrays of the function
+ */
+int frame_words(const ir::Function& func, const std::set<std::string>& globals) {
+    std::set<std::string> vars;
+    int words = 0;
+    for (const auto& para: func.ParameterList) vars.insert(para.name);
+    for (auto inst: func.InstVec) {
+        if (inst->op == Operator::alloc) words += std::stoi(inst->op1.name);
+        auto def = opt::def_of(inst);
+        if (def && !globals.count(def->name)) vars.insert(def->name);
+    }
+    return words + vars.size();
+}
+
+/**
+ * functions which can reach themselves through the call graph
+ */
+std::set<std::string> recursive_functions(const std::map<std::string, std::set<std::string>>& graph) {
+    std::set<std::string> res;
+    for (const auto& kv: graph) {
+        std::set<std::string> visited;
+        std::vector<std::string> work(kv.second.begin(), kv.second.end());
+        while (!work.empty()) {
+            auto name = work.back();
+            work.pop_back();
+            if (name == kv.first) {
+                res.insert(kv.first);
+                break;
+            }
+            if (!visited.insert(name).second || !graph.count(name)) continue;
+            for (const auto& next: graph.at(name)) work.push_back(next);
+        }
+    }
+    return res;
+}
+
+/**
+ * callees before callers, so an inlined body has already been expanded itself
+ */
+void post_order(const std::string& name, const std::map<std::string, std::set<std::string>>& graph,
+                std::set<std::string>& visited, std::vector<std::string>& order) {
+    if (!visited.insert(name).second || !graph.count(name)) return;
+    for (const auto& next: graph.at(name)) post_order(next, graph, visited, order);
+    order.push_back(name);
+}
+
+class Inliner {
+public:
+    Inliner(ir::Program& program, int threshold, const opt::Profile* profile): program(program), threshold(threshold), profile(profile) {}
+
+    int run() {
+        globals = opt::global_names(program);
+        std::map<std::string, std::set<std::string>> graph;
+        for (const auto& f: program.functions) {
+            graph[f.name] = callees_of(f);
+            for (auto inst: f.InstVec) {
+                if (inst->op == Operator::call && !opt::is_lib_call(inst)) call_sites[inst->op1.name]++;
+            }
+        }
+        recursive = recursive_functions(graph);
+        if (profile) {
+            for (const auto& f: profile->functions) {
+                if (f.first != "main") total_calls += f.second.calls;
+            }
+        }
+
+        std::set<std::string> visited;
+        std::vector<std::string> order;
+        for (const auto& f: program.functions) post_order(f.name, graph, visited, order);
+
+        int total = 0;
+        for (const auto& name: order) {
+            for (auto& f: program.functions) {
+                if (f.name == name) total += inline_into(f);
+            }
+        }
+        return total;
+    }
+
+private:
+    ir::Program& program;
+    int threshold;
+    const opt::Profile* profile;
+    unsigned long long total_calls = 0;
+    std::set<std::string> globals;
+    std::set<std::string> recursive;
+    std::map<std::string, int> call_sites;
+
+    bool should_inline(const ir::Function& caller, const ir::Instruction* inst, int caller_size, int& caller_frame) {
+        if (inst->op != Operator::call || opt::is_lib_call(inst)) return false;
+        auto callee = find_function(program, inst->op1.name);
+        if (!callee || callee == &caller || callee->name == "main" || callee->name == "global") return false;
+        if (recursive.count(callee->name)) return false;
+        int size = size_of(*callee);
+        if (caller_size + size > max_caller_size) return false;
+        int limit = threshold;
+        if (profile) {
+            auto calls = profile->calls(callee->name);
+            if (calls == 0 && call_sites[callee->name] != 1) return false;
+            if (calls > 0 && (unsigned long long)calls * opt::hot_call_share >= total_calls) limit *= opt::hot_inline_factor;
+        }
+        if (size > limit && (call_sites[callee->name] != 1 || size > single_site_factor * threshold)) return false;
+        int frame = frame_words(*callee, globals);
+        if (caller_frame + frame > max_frame_words) return false;
+        caller_frame += frame;
+        return true;
+    }
+
+    int inline_into(ir::Function& caller) {
+        auto& insts = caller.InstVec;
+        int caller_size = size_of(caller);
+        int caller_frame = frame_words(caller, globals);
+        std::vector<size_t> sites;
+        for (size_t i = 0; i < insts.size(); i++) {
+            if (should_inline(caller, insts[i], caller_size, caller_frame)) {
+                sites.push_back(i);
+                caller_size += size_of(*find_function(program, insts[i]->op1.name));
+            }
+        }
+        if (sites.empty()) return 0;
+
+        // remember jump targets as instructions (nullptr is the end of function), so the list can be rebuilt freely
+        std::map<ir::Instruction*, ir::Instruction*> target;
+        for (size_t i = 0; i < insts.size(); i++) {
+            if (insts[i]->op != Operator::_goto) continue;
+            size_t t = i + opt::goto_offset(insts[i]);
+            target[insts[i]] = t < insts.size() ? insts[t] : nullptr;
+        }
+
+        std::vector<ir::Instruction*> hoisted, body;
+        std::map<std::string, ir::Operand> shared_allocs;
+        // an inlined call is replaced by the first instruction of its copy, jumps to it are redirected there
+        std::map<ir::Instruction*, ir::Instruction*> replaced;
+        size_t next_site = 0;
+        for (size_t i = 0; i < insts.size(); i++) {
+            if (next_site < sites.size() && sites[next_site] == i) {
+                next_site++;
+                auto cont = i + 1 < insts.size() ? insts[i + 1] : nullptr;
+                auto start = body.size();
+                expand(dynamic_cast<ir::CallInst*>(insts[i]), cont, shared_allocs, hoisted, body, target);
+                replaced[insts[i]] = body.size() > start ? body[start] : cont;
+                continue;
+            }
+            body.push_back(insts[i]);
+        }
+
+        insts = hoisted;
+        insts.insert(insts.end(), body.begin(), body.end());
+        std::map<ir::Instruction*, int> index;
+        for (size_t i = 0; i < insts.size(); i++) index[insts[i]] = i;
+        for (size_t i = 0; i < insts.size(); i++) {
+            if (insts[i]->op != Operator::_goto) continue;
+            auto t = target.at(insts[i]);
+            while (t && replaced.count(t)) t = replaced[t];
+            int to = t ? index.at(t) : insts.size();
+            insts[i]->des = ir::Operand(std::to_string(to - static_cast<int>(i)), Type::IntLiteral);
+        }
+        return sites.size();
+    }
+
+    /**
+     * emit a renamed copy of the callee for the call into body
+     * @param cont: the instruction after the call, where the copied _return jumps to
+     */
+    void expand(ir::CallInst* call, ir::Instruction* cont, std::map<std::string, ir::Operand>& shared_allocs,
+                std::vector<ir::Instruction*>& hoisted, std::vector<ir::Instruction*>& body,
+                std::map<ir::Instruction*, ir::Instruction*>& target) {
+        assert(call && "call should be a ir::CallInst");
+        auto callee = find_function(program, call->op1.name);
+        auto tag = opt::fresh_name("inl");
+
+        std::map<std::string, ir::Operand> rename;
+        for (auto inst: callee->InstVec) {
+            if (inst->op != Operator::alloc) continue;
+            auto key = callee->name + "." + inst->des.name;
+            if (!shared_allocs.count(key)) {
+                shared_allocs[key] = ir::Operand(inst->des.name + "_" + tag, inst->des.type);
+                hoisted.push_back(new ir::Instruction(inst->op1, inst->op2, shared_allocs[key], Operator::alloc));
+            }
+            rename[inst->des.name] = shared_allocs[key];
+        }
+        auto rn = [&](const ir::Operand& op) {
+            if (!opt::is_var(op) || globals.count(op.name)) return op;
+            if (!rename.count(op.name)) rename[op.name] = ir::Operand(op.name + "_" + tag, op.type);
+            return rename[op.name];
+        };
+
+        // bind the parameters, a parameter which is never assigned by the callee is replaced by the argument itself
+        // (unless it is a global, which the callee may change)
+        std::set<std::string> assigned;
+        for (auto inst: callee->InstVec) {
+            auto def = opt::def_of(inst);
+            if (def) assigned.insert(def->name);
+        }
+        assert(callee->ParameterList.size() == call->argumentList.size());
+        for (size_t i = 0; i < callee->ParameterList.size(); i++) {
+            const auto& para = callee->ParameterList[i];
+            const auto& arg = call->argumentList[i];
+            if (!assigned.count(para.name) && (arg.type == Type::IntLiteral || (opt::is_var(arg) && !globals.count(arg.name)))) {
+                rename[para.name] = arg;
+                continue;
+            }
+            auto p = rn(para);
+            if (p.type == Type::Int) {
+                body.push_back(new ir::Instruction(arg, ir::Operand(), p, Operator::def));
+            }
+            else if (p.type == Type::Float) {
+                body.push_back(new ir::Instruction(arg, ir::Operand(), p, Operator::fdef));
+            }
+            else {
+                body.push_back(new ir::Instruction(arg, ir::Operand("0", Type::IntLiteral), p, Operator::getptr));
+            }
+        }
+
+        // copy the body, first[i] is the first copied instruction of callee->InstVec[i]
+        const auto& src = callee->InstVec;
+        std::vector<ir::Instruction*> first(src.size() + 1, nullptr);
+        std::vector<size_t> pending;
+        std::vector<std::pair<ir::Instruction*, size_t>> jumps;
+        auto emit = [&](ir::Instruction* inst) {
+            for (auto idx: pending) first[idx] = inst;
+            pending.clear();
+            body.push_back(inst);
+        };
+        for (size_t i = 0; i < src.size(); i++) {
+            pending.push_back(i);
+            auto inst = src[i];
+            switch (inst->op) {
+                case Operator::alloc:
+                    break;
+                case Operator::call: {
+                    auto c = new ir::CallInst(*dynamic_cast<ir::CallInst*>(inst));
+                    for (auto& arg: c->argumentList) arg = rn(arg);
+                    c->des = rn(c->des);
+                    emit(c);
+                } break;
+                case Operator::_goto: {
+                    auto g = new ir::Instruction(rn(inst->op1), inst->op2, inst->des, Operator::_goto);
+                    jumps.push_back({g, i + opt::goto_offset(inst)});
+                    emit(g);
+                } break;
+                case Operator::_return: {
+                    if (call->des.type != Type::null && inst->op1.type != Type::null) {
+                        auto val = rn(inst->op1);
+                        if (call->des.type == Type::Float) {
+                            if (val.type == Type::IntLiteral) val.type = Type::FloatLiteral;
+                            emit(new ir::Instruction(val, ir::Operand(), call->des, Operator::fmov));
+                        }
+                        else {
+                            emit(new ir::Instruction(val, ir::Operand(), call->des, Operator::mov));
+                        }
+                    }
+                    if (i + 1 < src.size()) {
+                        auto g = new ir::Instruction(ir::Operand("null", Type::null), ir::Operand(), ir::Operand(), Operator::_goto);
+                        target[g] = cont;
+                        emit(g);
+                    }
+                } break;
+                default:
+                    emit(new ir::Instruction(rn(inst->op1), rn(inst->op2), rn(inst->des), inst->op));
+                    break;
+            }
+        }
+        pending.push_back(src.size());
+        for (auto idx: pending) first[idx] = cont;
+        for (const auto& j: jumps) {
+            assert(j.second <= src.size());
+            target[j.first] = first[j.second];
+        }
+    }
+};
+
+} // namespace
+
+int opt::inline_functions(ir::Program& program, int threshold, const Profile* profile) {
+    return Inliner(program, threshold, profile).run();
+}
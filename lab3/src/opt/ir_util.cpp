@@ -0,0 +1,138 @@
+#include "opt/ir_util.h"
+#include "front/semantic.h"
+
+#include<cassert>
+
+using ir::Type;
+using ir::Operator;
+
+bool opt::is_var(const ir::Operand& op) {
+    return op.type != Type::IntLiteral && op.type != Type::FloatLiteral && op.type != Type::null
+        && !op.name.empty() && op.name != "null";
+}
+
+std::vector<ir::Operand> opt::uses_of(const ir::Instruction* inst) {
+    std::vector<ir::Operand> res;
+    auto add = [&](const ir::Operand& op) { if (is_var(op)) res.push_back(op); };
+    switch (inst->op) {
+        case Operator::call: {
+            auto callinst = dynamic_cast<const ir::CallInst*>(inst);
+            assert(callinst && "call should be a ir::CallInst");
+            for (const auto& arg: callinst->argumentList) add(arg);
+        } break;
+        case Operator::_return:
+        case Operator::_goto:
+            add(inst->op1);
+            break;
+        case Operator::store:       // des is the value to be stored
+            add(inst->des);
+            add(inst->op1);
+            add(inst->op2);
+            break;
+        case Operator::alloc:
+        case Operator::__unuse__:
+            break;
+        default:
+            add(inst->op1);
+            add(inst->op2);
+            break;
+    }
+    return res;
+}
+
+const ir::Operand* opt::def_of(const ir::Instruction* inst) {
+    switch (inst->op) {
+        case Operator::_return:
+        case Operator::_goto:
+        case Operator::store:
+        case Operator::memset:
+        case Operator::__unuse__:
+            return nullptr;
+        default:
+            return is_var(inst->des) ? &inst->des : nullptr;
+    }
+}
+
+bool opt::is_lib_call(const ir::Instruction* inst) {
+    auto lib_funcs = frontend::get_lib_funcs();
+    return inst->op == Operator::call && lib_funcs->find(inst->op1.name) != lib_funcs->end();
+}
+
+std::set<std::string> opt::global_names(const ir::Program& program) {
+    std::set<std::string> res;
+    for (const auto& gv: program.globalVal) res.insert(gv.val.name);
+    return res;
+}
+
+std::map<std::string, int> opt::int_constants(const ir::Function& func, const std::set<std::string>& globals) {
+    std::map<std::string, int> def_cnt;
+    std::map<std::string, const ir::Instruction*> def_inst;
+    for (auto inst: func.InstVec) {
+        auto def = def_of(inst);
+        if (!def) continue;
+        def_cnt[def->name]++;
+        def_inst[def->name] = inst;
+    }
+    for (const auto& param: func.ParameterList) def_cnt[param.name]++;
+
+    // a copy of a constant is a constant too, as the copied variable is also defined only once,
+    // and so is the sum, difference or product of two constants, which is how negative literals come out of the frontend
+    std::map<std::string, int> res;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& it: def_inst) {
+            auto inst = it.second;
+            if (def_cnt[it.first] != 1 || res.count(it.first) || globals.count(it.first) || inst->des.type != Type::Int) continue;
+            int val, a, b;
+            switch (inst->op) {
+                case Operator::def: case Operator::mov:
+                    if (!get_int_constant(inst->op1, res, val)) continue;
+                    break;
+                case Operator::add: case Operator::addi: case Operator::sub: case Operator::subi: case Operator::mul: {
+                    if (!get_int_constant(inst->op1, res, a) || !get_int_constant(inst->op2, res, b)) continue;
+                    // wrapping like the target does
+                    uint32_t ua = a, ub = b;
+                    bool is_sub = inst->op == Operator::sub || inst->op == Operator::subi;
+                    val = static_cast<int>(inst->op == Operator::mul ? ua * ub : is_sub ? ua - ub : ua + ub);
+                    break;
+                }
+                default:
+                    continue;
+            }
+            res[it.first] = val;
+            changed = true;
+        }
+    }
+    return res;
+}
+
+bool opt::get_int_constant(const ir::Operand& op, const std::map<std::string, int>& consts, int& val) {
+    if (op.type == Type::IntLiteral) {
+        val = std::stoi(op.name);
+        return true;
+    }
+    auto it = consts.find(op.name);
+    if (op.type != Type::Int || it == consts.end()) return false;
+    val = it->second;
+    return true;
+}
+
+int opt::goto_offset(const ir::Instruction* inst) {
+    assert(inst->op == Operator::_goto);
+    return std::stoi(inst->des.name);
+}
+
+ir::Instruction* opt::clone(const ir::Instruction* inst) {
+    if (inst->op == Operator::call) {
+        auto callinst = dynamic_cast<const ir::CallInst*>(inst);
+        assert(callinst && "call should be a ir::CallInst");
+        return new ir::CallInst(*callinst);
+    }
+    return new ir::Instruction(*inst);
+}
+
+std::string opt::fresh_name(const std::string& hint) {
+    static int cnt = 0;
+    return hint + "_" + std::to_string(cnt++) + "_opt";
+}
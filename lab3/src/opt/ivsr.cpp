@@ -0,0 +1,350 @@
+#include "opt/ivsr.h"
+#include "opt/ir_util.h"
+#include "opt/cfg.h"
+#include "opt/loop.h"
+
+#include<map>
+#include<list>
+#include<set>
+#include<tuple>
+#include<vector>
+#include<string>
+#include<algorithm>
+
+using ir::Type;
+using ir::Operand;
+using ir::Operator;
+
+namespace {
+
+// a basic induction variable, updated by var = tmp, tmp = var + step
+struct BasicIV {
+    std::string var;
+    int step;
+    ir::Instruction* update;                    // the instruction which writes var
+};
+
+// an affine function of a basic induction variable: scale * iv + base + offset, base is loop invariant or null
+struct Affine {
+    const BasicIV* iv;
+    int scale;
+    Operand base;
+    int offset;
+};
+
+// array accesses sharing the same address expression are rewritten to the same pointer
+struct PtrKey {
+    std::string arr, iv, base;
+    int scale, offset;
+    bool operator<(const PtrKey& o) const {
+        return std::tie(arr, iv, base, scale, offset) < std::tie(o.arr, o.iv, o.base, o.scale, o.offset);
+    }
+};
+
+struct LoopReducer {
+    opt::CFG& cfg;
+    const opt::DomTree& dom;
+    opt::Loop* loop;
+    const std::set<std::string>& globals;
+    const std::map<std::string, int>& consts;
+    std::set<std::string> params;
+
+    std::map<std::string, int> def_cnt;
+    std::map<std::string, ir::Instruction*> def_inst;           // the only definition in loop
+    std::map<std::string, opt::BasicBlock*> def_block;
+    std::map<std::string, BasicIV> ivs;
+    std::map<std::string, Affine> affines;
+    std::map<PtrKey, Operand> ptrs;
+    std::vector<std::pair<PtrKey, Affine>> inits;
+
+    LoopReducer(opt::CFG& c, const opt::DomTree& d, opt::Loop* l, const std::set<std::string>& g, const std::map<std::string, int>& k)
+        : cfg(c), dom(d), loop(l), globals(g), consts(k) {
+        for (const auto& p: cfg.func->ParameterList) params.insert(p.name);
+        for (auto bb: cfg.blocks) {
+            if (!loop->contains(bb)) continue;
+            for (auto inst: bb->insts) {
+                auto def = opt::def_of(inst);
+                if (!def) continue;
+                def_cnt[def->name]++;
+                def_inst[def->name] = inst;
+                def_block[def->name] = bb;
+            }
+        }
+    }
+
+    bool has_call() const {
+        for (auto bb: loop->blocks) {
+            for (auto inst: bb->insts) {
+                if (inst->op == Operator::call && !opt::is_lib_call(inst)) return true;
+            }
+        }
+        return false;
+    }
+
+    bool is_invariant(const Operand& op) const {
+        return !opt::is_var(op) || !def_cnt.count(op.name);
+    }
+
+    // the variable holds a value when the loop is entered: it is a global, a parameter or defined before the header
+    bool defined_on_entry(const std::string& var) const {
+        if (globals.count(var) || params.count(var)) return true;
+        for (auto bb: cfg.blocks) {
+            if (loop->contains(bb) || !dom.dominates(bb, loop->header)) continue;
+            for (auto inst: bb->insts) {
+                auto def = opt::def_of(inst);
+                if (def && def->name == var) return true;
+            }
+        }
+        return false;
+    }
+
+    void find_basic_ivs() {
+        for (const auto& it: def_inst) {
+            auto inst = it.second;
+            if (def_cnt[it.first] != 1 || inst->des.type != Type::Int || globals.count(it.first)) continue;
+            if (inst->op != Operator::def && inst->op != Operator::mov) continue;
+            // var = tmp
+            const auto& tmp = inst->op1;
+            if (!opt::is_var(tmp) || def_cnt[tmp.name] != 1 || def_block[tmp.name] != def_block[it.first]) continue;
+            auto tinst = def_inst[tmp.name];
+            auto& insts = def_block[it.first]->insts;
+            if (std::find(insts.begin(), insts.end(), tinst) > std::find(insts.begin(), insts.end(), inst)) continue;
+            // tmp = var + c
+            int c;
+            bool ok = false;
+            switch (tinst->op) {
+                case Operator::add:
+                    ok = (tinst->op1.name == it.first && opt::get_int_constant(tinst->op2, consts, c))
+                      || (tinst->op2.name == it.first && opt::get_int_constant(tinst->op1, consts, c));
+                    break;
+                case Operator::addi:
+                case Operator::sub:
+                case Operator::subi:
+                    ok = tinst->op1.name == it.first && opt::get_int_constant(tinst->op2, consts, c);
+                    if (tinst->op != Operator::addi) c = -c;
+                    break;
+                default:
+                    break;
+            }
+            if (ok && defined_on_entry(it.first)) ivs[it.first] = {it.first, c, inst};
+        }
+    }
+
+    // try to express op as an affine function of a basic iv at the point it is read
+    bool get_affine(const Operand& op, Affine& res) const {
+        if (!opt::is_var(op) || op.type != Type::Int) return false;
+        auto iv = ivs.find(op.name);
+        if (iv != ivs.end()) {
+            res = {&iv->second, 1, Operand(), 0};
+            return true;
+        }
+        auto af = affines.find(op.name);
+        if (af == affines.end()) return false;
+        res = af->second;
+        return true;
+    }
+
+    // derived induction variables, defined once in loop from a basic iv or another derived one
+    void find_derived_ivs() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (const auto& it: def_inst) {
+                if (def_cnt[it.first] != 1 || ivs.count(it.first) || affines.count(it.first) || globals.count(it.first)) continue;
+                auto inst = it.second;
+                if (inst->des.type != Type::Int) continue;
+                Affine a, res;
+                int c;
+                bool ok = false;
+                switch (inst->op) {
+                    case Operator::def:
+                    case Operator::mov:
+                        ok = get_affine(inst->op1, res);
+                        break;
+                    case Operator::mul:
+                        if ((get_affine(inst->op1, a) && opt::get_int_constant(inst->op2, consts, c))
+                         || (get_affine(inst->op2, a) && opt::get_int_constant(inst->op1, consts, c))) {
+                            ok = !opt::is_var(a.base);
+                            res = {a.iv, a.scale * c, Operand(), a.offset * c};
+                        }
+                        break;
+                    case Operator::add:
+                    case Operator::addi:
+                    case Operator::sub:
+                    case Operator::subi: {
+                        bool neg = inst->op == Operator::sub || inst->op == Operator::subi;
+                        const Operand* other = nullptr;
+                        if (get_affine(inst->op1, a)) other = &inst->op2;
+                        else if (!neg && get_affine(inst->op2, a)) other = &inst->op1;
+                        if (!other) break;
+                        res = a;
+                        if (opt::get_int_constant(*other, consts, c)) {
+                            res.offset += neg ? -c : c;
+                            ok = true;
+                        }
+                        else if (!neg && !opt::is_var(a.base) && is_invariant(*other) && other->type == Type::Int) {
+                            res.base = *other;
+                            ok = true;
+                        }
+                    } break;
+                    default:
+                        break;
+                }
+                if (ok) {
+                    affines[it.first] = res;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // the access reads index at the same value as the affine function evaluated at this point
+    bool index_is_current(const Operand& index, opt::BasicBlock* bb, size_t pos, const Affine& af) const {
+        if (ivs.count(index.name)) return true;
+        // every link of the chain down to the iv is defined earlier in this block than its user,
+        // and the iv is not updated between the first link and the access
+        size_t first = pos;
+        std::vector<std::pair<std::string, size_t>> work = {{index.name, pos}};
+        while (!work.empty()) {
+            auto name = work.back().first;
+            auto user_pos = work.back().second;
+            work.pop_back();
+            if (def_block.at(name) != bb) return false;
+            auto inst = def_inst.at(name);
+            size_t def_pos = std::find(bb->insts.begin(), bb->insts.end(), inst) - bb->insts.begin();
+            if (def_pos >= user_pos) return false;
+            first = std::min(first, def_pos);
+            for (auto op: {&inst->op1, &inst->op2}) {
+                if (opt::is_var(*op) && affines.count(op->name)) work.push_back({op->name, def_pos});
+            }
+        }
+        for (size_t i = first + 1; i < pos; i++) {
+            if (bb->insts[i] == af.iv->update) return false;
+        }
+        return true;
+    }
+
+    // rewrite the accesses to pointers, the pointers are set up by insert_pointers()
+    int run() {
+        if (has_call()) return 0;       // keep it simple, a call may change global ivs or bases
+        find_basic_ivs();
+        if (ivs.empty()) return 0;
+        find_derived_ivs();
+
+        int cnt = 0;
+        for (auto bb: cfg.blocks) {
+            if (!loop->contains(bb) || !dom.reachable[bb->index]) continue;
+            for (size_t pos = 0; pos < bb->insts.size(); pos++) {
+                auto inst = bb->insts[pos];
+                if (inst->op != Operator::load && inst->op != Operator::store) continue;
+                const auto& arr = inst->op1;
+                Affine af;
+                if (!is_invariant(arr) || !defined_on_entry(arr.name) || !get_affine(inst->op2, af)) continue;
+                if (opt::is_var(af.base) && !defined_on_entry(af.base.name)) continue;
+                if (!index_is_current(inst->op2, bb, pos, af)) continue;
+
+                PtrKey key = {arr.name, af.iv->var, af.base.name, af.scale, af.offset};
+                if (!ptrs.count(key)) {
+                    ptrs[key] = Operand(opt::fresh_name("ivsr"), arr.type);
+                    inits.push_back({key, af});
+                }
+                inst->op1 = ptrs[key];
+                inst->op2 = Operand("0", Type::IntLiteral);
+                cnt++;
+            }
+        }
+        return cnt;
+    }
+
+    // it changes the CFG, so it runs after the other loops are analysed
+    void insert_pointers() {
+        // p = A + scale * iv + base + offset, before the loop
+        auto preheader = opt::insert_preheader(cfg, loop);
+        for (const auto& it: inits) {
+            const auto& af = it.second;
+            auto ptr = ptrs[it.first];
+            Operand iv(af.iv->var, Type::Int);
+            Operand idx = iv;
+            if (af.scale != 1) {
+                idx = Operand(opt::fresh_name("ivsr"), Type::Int);
+                preheader->insts.push_back(new ir::Instruction(iv, Operand(std::to_string(af.scale), Type::IntLiteral), idx, Operator::mul));
+            }
+            if (opt::is_var(af.base)) {
+                Operand sum(opt::fresh_name("ivsr"), Type::Int);
+                preheader->insts.push_back(new ir::Instruction(idx, af.base, sum, Operator::add));
+                idx = sum;
+            }
+            if (af.offset) {
+                Operand sum(opt::fresh_name("ivsr"), Type::Int);
+                preheader->insts.push_back(new ir::Instruction(idx, Operand(std::to_string(af.offset), Type::IntLiteral), sum, Operator::addi));
+                idx = sum;
+            }
+            preheader->insts.push_back(new ir::Instruction(Operand(it.first.arr, ptr.type), idx, ptr, Operator::getptr));
+        }
+
+        // p += scale * step, right after the iv is updated
+        for (auto bb: cfg.blocks) {
+            if (!loop->contains(bb)) continue;
+            for (auto pos = bb->insts.begin(); pos != bb->insts.end(); ++pos) {
+                for (const auto& it: inits) {
+                    if (*pos != it.second.iv->update) continue;
+                    auto ptr = ptrs[it.first];
+                    auto step = Operand(std::to_string(it.second.scale * it.second.iv->step), Type::IntLiteral);
+                    pos = bb->insts.insert(pos + 1, new ir::Instruction(ptr, step, ptr, Operator::getptr)) - 1;
+                }
+            }
+        }
+    }
+};
+
+// like licm, every loop without a changed loop inside is handled in a round sharing the analyses
+int ivsr_function(ir::Function& func, const std::set<std::string>& globals) {
+    int total = 0;
+    bool first_round = true;
+    std::set<ir::Instruction*> pending;             // identify a loop by the first instruction of its header
+    while (first_round || !pending.empty()) {
+        opt::CFG cfg(&func);
+        opt::DomTree dom(cfg);
+        opt::LoopInfo loops(cfg, dom);
+        if (loops.loops.empty()) break;
+        auto consts = opt::int_constants(func, globals);
+
+        std::set<opt::Loop*> blocked;               // loops containing a changed loop
+        std::set<ir::Instruction*> next;
+        std::list<LoopReducer> changed;             // Affine points into its reducer, so they are never moved
+        for (auto loop: loops.loops) {
+            auto header = loop->header->insts.front();
+            if (!first_round && !pending.count(header)) continue;
+            if (blocked.count(loop)) {
+                next.insert(header);
+                continue;
+            }
+            changed.emplace_back(cfg, dom, loop, globals, consts);
+            int cnt = changed.back().run();
+            if (!cnt) {
+                changed.pop_back();
+                continue;
+            }
+            total += cnt;
+            for (auto p = loop->parent; p; p = p->parent) blocked.insert(p);
+        }
+        if (changed.empty()) break;
+
+        for (auto& reducer: changed) reducer.insert_pointers();
+        cfg.linearize();
+        pending = next;
+        first_round = false;
+    }
+    return total;
+}
+
+} // namespace
+
+int opt::ivsr(ir::Program& program) {
+    auto globals = global_names(program);
+    int total = 0;
+    for (auto& func: program.functions) {
+        total += ivsr_function(func, globals);
+    }
+    return total;
+}
@@ -0,0 +1,186 @@
+#include "opt/licm.h"
+#include "opt/ir_util.h"
+#include "opt/cfg.h"
+#include "opt/loop.h"
+#include "opt/liveness.h"
+
+#include<map>
+#include<set>
+#include<string>
+#include<vector>
+#include<algorithm>
+
+using ir::Operator;
+
+namespace {
+
+// instructions which only compute a value from its operands
+bool is_hoistable_op(Operator op) {
+    switch (op) {
+        case Operator::def: case Operator::fdef: case Operator::mov: case Operator::fmov:
+        case Operator::cvt_i2f: case Operator::cvt_f2i:
+        case Operator::add: case Operator::addi: case Operator::sub: case Operator::subi: case Operator::mul:
+        case Operator::fadd: case Operator::fsub: case Operator::fmul: case Operator::fdiv:
+        case Operator::lss: case Operator::leq: case Operator::gtr: case Operator::geq: case Operator::eq: case Operator::neq:
+        case Operator::flss: case Operator::fleq: case Operator::fgtr: case Operator::fgeq: case Operator::feq: case Operator::fneq:
+        case Operator::_not: case Operator::_and: case Operator::_or:
+        case Operator::getptr: case Operator::alloc:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// instructions which may trap or read memory, they can only be hoisted if they are executed in every iteration
+bool is_guarded_op(Operator op) {
+    return op == Operator::div || op == Operator::mod || op == Operator::load;
+}
+
+struct LoopHoister {
+    opt::CFG& cfg;
+    const opt::DomTree& dom;
+    const opt::Liveness& live;
+    const std::set<std::string>& globals;
+    opt::Loop* loop;
+
+    std::vector<opt::BasicBlock*> body;         // blocks of the loop in layout order
+    std::map<std::string, int> def_cnt;         // number of definitions inside the loop
+    bool has_user_call = false;                 // a call may change any global variable
+    bool writes_memory = false;                 // store, memset or call, loads can not be hoisted
+    std::vector<opt::BasicBlock*> exiting;
+    std::set<std::string> live_at_exit;
+    std::set<std::string> invariant;            // variables defined by hoisted instructions
+
+    LoopHoister(opt::CFG& c, const opt::DomTree& d, const opt::Liveness& l, const std::set<std::string>& g, opt::Loop* lp)
+        : cfg(c), dom(d), live(l), globals(g), loop(lp), body(lp->blocks.begin(), lp->blocks.end()) {
+        std::sort(body.begin(), body.end(), [](const opt::BasicBlock* a, const opt::BasicBlock* b) { return a->index < b->index; });
+        for (auto bb: body) {
+            for (auto inst: bb->insts) {
+                if (auto def = opt::def_of(inst)) def_cnt[def->name]++;
+                if (inst->op == Operator::call) {
+                    writes_memory = true;
+                    if (!opt::is_lib_call(inst)) has_user_call = true;
+                }
+                if (inst->op == Operator::store || inst->op == Operator::memset) writes_memory = true;
+            }
+        }
+        exiting = loop->exiting_blocks(cfg);
+        for (auto bb: loop->exit_blocks(cfg)) {
+            live_at_exit.insert(live.live_in[bb->index].begin(), live.live_in[bb->index].end());
+        }
+    }
+
+    bool is_invariant(const ir::Operand& op) const {
+        if (!opt::is_var(op)) return true;
+        if (invariant.count(op.name)) return true;
+        if (def_cnt.count(op.name)) return false;
+        return !(has_user_call && globals.count(op.name));
+    }
+
+    // bb is executed in every iteration that leaves the loop
+    bool dominates_exits(const opt::BasicBlock* bb) const {
+        return std::all_of(exiting.begin(), exiting.end(), [&](const opt::BasicBlock* e) { return dom.dominates(bb, e); });
+    }
+
+    bool can_hoist(const ir::Instruction* inst, const opt::BasicBlock* bb) const {
+        if (is_guarded_op(inst->op)) {
+            if (!dominates_exits(bb)) return false;
+            if (inst->op == Operator::load && writes_memory) return false;
+        }
+        else if (!is_hoistable_op(inst->op)) {
+            return false;
+        }
+        auto def = opt::def_of(inst);
+        if (!def || globals.count(def->name) || def_cnt.at(def->name) != 1) return false;
+        // the old value must not be read in the loop before this definition
+        if (live.live_in[loop->header->index].count(def->name)) return false;
+        // the value after loop must be the same even if the loop body does not run
+        if (live_at_exit.count(def->name) && !dominates_exits(bb)) return false;
+        for (const auto& use: opt::uses_of(inst)) {
+            if (!is_invariant(use)) return false;
+        }
+        return true;
+    }
+
+    // returns the hoisted instructions in their dependence order
+    std::vector<ir::Instruction*> collect() {
+        std::vector<ir::Instruction*> res;
+        std::set<ir::Instruction*> hoisted;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto bb: body) {
+                if (!dom.reachable[bb->index]) continue;
+                for (auto inst: bb->insts) {
+                    if (hoisted.count(inst) || !can_hoist(inst, bb)) continue;
+                    hoisted.insert(inst);
+                    invariant.insert(opt::def_of(inst)->name);
+                    res.push_back(inst);
+                    changed = true;
+                }
+            }
+        }
+        return res;
+    }
+};
+
+// the analyses are built once per round, and every loop without a changed loop inside is handled in it.
+// hoisting out of a loop leaves the liveness and dominance of the blocks outside of it unchanged,
+// only the loops containing it have to wait for the next round to see its preheader
+int licm_function(ir::Function& func, const std::set<std::string>& globals) {
+    int total = 0;
+    bool first_round = true;
+    std::set<ir::Instruction*> pending;             // identify a loop by the first instruction of its header
+    while (first_round || !pending.empty()) {
+        opt::CFG cfg(&func);
+        opt::DomTree dom(cfg);
+        opt::LoopInfo loops(cfg, dom);
+        if (loops.loops.empty()) break;
+        opt::Liveness live(cfg, globals);
+
+        std::set<opt::Loop*> blocked;               // loops containing a changed loop
+        std::set<ir::Instruction*> next;
+        std::vector<std::pair<opt::Loop*, std::vector<ir::Instruction*>>> changes;
+        for (auto loop: loops.loops) {
+            auto header = loop->header->insts.front();
+            if (!first_round && !pending.count(header)) continue;
+            if (blocked.count(loop)) {
+                next.insert(header);
+                continue;
+            }
+            auto hoisted = LoopHoister(cfg, dom, live, globals, loop).collect();
+            if (hoisted.empty()) continue;
+            changes.push_back({loop, hoisted});
+            for (auto p = loop->parent; p; p = p->parent) blocked.insert(p);
+        }
+        if (changes.empty()) break;
+
+        for (const auto& it: changes) {
+            auto loop = it.first;
+            const auto& hoisted = it.second;
+            std::set<ir::Instruction*> hoisted_set(hoisted.begin(), hoisted.end());
+            for (auto bb: loop->blocks) {
+                auto& insts = bb->insts;
+                insts.erase(std::remove_if(insts.begin(), insts.end(), [&](ir::Instruction* i) { return hoisted_set.count(i) != 0; }), insts.end());
+            }
+            auto preheader = opt::insert_preheader(cfg, loop);
+            preheader->insts = hoisted;
+            total += hoisted.size();
+        }
+        cfg.linearize();
+        pending = next;
+        first_round = false;
+    }
+    return total;
+}
+
+} // namespace
+
+int opt::licm(ir::Program& program) {
+    auto globals = global_names(program);
+    int total = 0;
+    for (auto& func: program.functions) {
+        total += licm_function(func, globals);
+    }
+    return total;
+}
@@ -0,0 +1,38 @@
+#include "opt/liveness.h"
+#include "opt/ir_util.h"
+
+using ir::Operator;
+
+void opt::Liveness::step(const ir::Instruction* inst, std::set<std::string>& live, const std::set<std::string>& globals) {
+    auto def = def_of(inst);
+    if (def) live.erase(def->name);
+    for (const auto& use: uses_of(inst)) live.insert(use.name);
+    if (inst->op == Operator::_return || (inst->op == Operator::call && !is_lib_call(inst))) {
+        live.insert(globals.begin(), globals.end());
+    }
+}
+
+opt::Liveness::Liveness(const CFG& cfg, const std::set<std::string>& globals): 
+    live_in(cfg.blocks.size()), live_out(cfg.blocks.size()) {
+    auto order = cfg.reverse_post_order();
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        // backward problem, visit blocks in post order
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            auto bb = *it;
+            std::set<std::string> live;
+            for (auto succ: bb->succs()) {
+                live.insert(live_in[succ->index].begin(), live_in[succ->index].end());
+            }
+            live_out[bb->index] = live;
+            for (auto inst = bb->insts.rbegin(); inst != bb->insts.rend(); ++inst) {
+                step(*inst, live, globals);
+            }
+            if (live != live_in[bb->index]) {
+                live_in[bb->index] = std::move(live);
+                changed = true;
+            }
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#include "opt/loop.h"
+
+#include<map>
+#include<algorithm>
+
+bool opt::Loop::contains(const BasicBlock* bb) const {
+    return blocks.count(const_cast<BasicBlock*>(bb)) != 0;
+}
+
+std::vector<opt::BasicBlock*> opt::Loop::exiting_blocks(const CFG& cfg) const {
+    std::vector<BasicBlock*> res;
+    for (auto bb: cfg.blocks) {
+        if (!contains(bb)) continue;
+        for (auto succ: bb->succs()) {
+            if (!contains(succ)) {
+                res.push_back(bb);
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+std::vector<opt::BasicBlock*> opt::Loop::exit_blocks(const CFG& cfg) const {
+    std::set<BasicBlock*> exits;
+    for (auto bb: blocks) {
+        for (auto succ: bb->succs()) {
+            if (!contains(succ)) exits.insert(succ);
+        }
+    }
+    std::vector<BasicBlock*> res;
+    for (auto bb: cfg.blocks) {
+        if (exits.count(bb)) res.push_back(bb);
+    }
+    return res;
+}
+
+opt::LoopInfo::LoopInfo(const CFG& cfg, const DomTree& dom): innermost(cfg.blocks.size(), nullptr) {
+    // find back edges, loops sharing a header are merged
+    std::map<BasicBlock*, Loop*> loop_of_header;
+    for (auto bb: cfg.blocks) {
+        if (!dom.reachable[bb->index]) continue;
+        for (auto succ: bb->succs()) {
+            if (!dom.dominates(succ, bb)) continue;
+            auto& loop = loop_of_header[succ];
+            if (!loop) {
+                loop = new Loop();
+                loop->header = succ;
+                loop->blocks.insert(succ);
+                loops.push_back(loop);
+            }
+            loop->latches.push_back(bb);
+            // collect the body by walking backward from the latch
+            std::vector<BasicBlock*> worklist = {bb};
+            while (worklist.size()) {
+                auto cur = worklist.back();
+                worklist.pop_back();
+                if (!loop->blocks.insert(cur).second) continue;
+                for (auto pred: cur->preds) {
+                    if (dom.reachable[pred->index]) worklist.push_back(pred);
+                }
+            }
+        }
+    }
+
+    // build the nest forest, a loop's parent is the smallest loop containing its header
+    std::stable_sort(loops.begin(), loops.end(), [](const Loop* a, const Loop* b) {
+        return a->blocks.size() < b->blocks.size();
+    });
+    for (size_t i = 0; i < loops.size(); i++) {
+        for (size_t j = i + 1; j < loops.size(); j++) {
+            if (loops[j]->blocks.size() > loops[i]->blocks.size() && loops[j]->contains(loops[i]->header)) {
+                loops[i]->parent = loops[j];
+                loops[j]->children.push_back(loops[i]);
+                break;
+            }
+        }
+        if (!loops[i]->parent) top_level.push_back(loops[i]);
+    }
+    // parents come after children, so walk backward to set depth
+    for (auto it = loops.rbegin(); it != loops.rend(); ++it) {
+        if ((*it)->parent) (*it)->depth = (*it)->parent->depth + 1;
+    }
+    for (auto loop: loops) {
+        for (auto bb: loop->blocks) {
+            if (!innermost[bb->index]) innermost[bb->index] = loop;
+        }
+    }
+}
+
+opt::LoopInfo::~LoopInfo() {
+    for (auto loop: loops) delete loop;
+}
+
+opt::Loop* opt::LoopInfo::loop_of(const BasicBlock* bb) const {
+    return bb->index < (int)innermost.size() ? innermost[bb->index] : nullptr;
+}
+
+int opt::LoopInfo::depth_of(const BasicBlock* bb) const {
+    auto loop = loop_of(bb);
+    return loop ? loop->depth : 0;
+}
+
+opt::BasicBlock* opt::insert_preheader(CFG& cfg, Loop* loop) {
+    auto header = loop->header;
+    auto pre = cfg.insert_block_before(header);
+    for (auto bb: cfg.blocks) {
+        if (bb == pre || loop->contains(bb)) continue;
+        if (bb->jump_target == header) bb->jump_target = pre;
+        if (bb->fall_through == header) bb->fall_through = pre;
+    }
+    pre->fall_through = header;
+    for (auto p = loop->parent; p; p = p->parent) p->blocks.insert(pre);
+    cfg.update();
+    return pre;
+}
@@ -0,0 +1,170 @@
+#include "opt/pass_manager.h"
+#include "opt/verifier.h"
+#include "opt/tre.h"
+#include "opt/inliner.h"
+#include "opt/sroa.h"
+#include "opt/licm.h"
+#include "opt/ivsr.h"
+#include "opt/unroll.h"
+#include "opt/dce.h"
+
+#include<chrono>
+#include<algorithm>
+#include<cstdio>
+#include<cassert>
+#include<iostream>
+
+namespace {
+
+// a pass of the pipeline, it is run from level min_level on
+struct PassEntry {
+    std::string name;
+    int min_level;
+    std::function<int(ir::Program&, const opt::PassOptions&)> run;
+};
+
+const std::vector<PassEntry>& pass_table() {
+    static const std::vector<PassEntry> table = {
+        {"tre",     1, [](ir::Program& p, const opt::PassOptions&) { return opt::tre(p); }},
+        {"inline",  1, [](ir::Program& p, const opt::PassOptions& o) { return opt::inline_functions(p, o.inline_threshold, o.profile.get()); }},
+        {"sroa",    1, [](ir::Program& p, const opt::PassOptions&) { return opt::sroa(p); }},
+        {"licm",    1, [](ir::Program& p, const opt::PassOptions&) { return opt::licm(p); }},
+        {"ivsr",    1, [](ir::Program& p, const opt::PassOptions&) { return opt::ivsr(p); }},
+        {"unroll",  1, [](ir::Program& p, const opt::PassOptions& o) { return opt::unroll(p, o.unroll_factor); }},
+        {"dce",     1, [](ir::Program& p, const opt::PassOptions&) { return opt::dce(p); }},
+    };
+    return table;
+}
+
+// -O2 runs another round of these after the -O1 pipeline, to clean up what inlining and unrolling exposed
+const std::vector<std::string> o2_cleanup = {"licm", "dce"};
+
+int inst_count(const ir::Program& program) {
+    int cnt = 0;
+    for (const auto& func: program.functions) cnt += func.InstVec.size();
+    return cnt;
+}
+
+bool starts_with(const std::string& s, const std::string& prefix) {
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+} // namespace
+
+bool opt::PassOptions::parse(const std::string& arg) {
+    if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+        level = arg[2] - '0';
+    }
+    else if (starts_with(arg, "-finline-threshold=")) {
+        inline_threshold = std::stoi(arg.substr(std::string("-finline-threshold=").size()));
+    }
+    else if (starts_with(arg, "-funroll=")) {
+        unroll_factor = std::stoi(arg.substr(std::string("-funroll=").size()));
+    }
+    else if (arg == "-time-passes") {
+        time_passes = true;
+    }
+    else if (arg == "-verify-each") {
+        verify = true;
+    }
+    else if (starts_with(arg, "-fprofile-use=")) {
+        profile_file = arg.substr(std::string("-fprofile-use=").size());
+    }
+    else if (starts_with(arg, "-fno-")) {
+        disabled.insert(arg.substr(5));
+    }
+    else if (starts_with(arg, "-f")) {
+        enabled.insert(arg.substr(2));
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+opt::PassManager::PassManager(const PassOptions& opts): options(opts) {
+    if (!options.profile_file.empty() && !options.profile) {
+        auto profile = std::make_shared<Profile>();
+        bool ok = profile->load(options.profile_file);
+        assert(ok && "-fprofile-use=<file>: can not read the profile");
+        (void)ok;
+        options.profile = profile;
+    }
+    auto names = pass_names();
+    for (const auto& name: options.enabled) {
+        assert(std::find(names.begin(), names.end(), name) != names.end() && "-f<pass>: unknown pass");
+    }
+    for (const auto& name: options.disabled) {
+        assert(std::find(names.begin(), names.end(), name) != names.end() && "-fno-<pass>: unknown pass");
+    }
+
+    auto add = [&](const PassEntry& entry) {
+        auto run = entry.run;
+        auto o = options;
+        passes.push_back({entry.name, [run, o](ir::Program& p) { return run(p, o); }});
+    };
+    for (const auto& entry: pass_table()) {
+        if (options.disabled.count(entry.name)) continue;
+        if (entry.min_level <= options.level || options.enabled.count(entry.name)) add(entry);
+    }
+    if (options.level >= 2) {
+        for (const auto& name: o2_cleanup) {
+            if (options.disabled.count(name)) continue;
+            for (const auto& entry: pass_table()) {
+                if (entry.name == name) add(entry);
+            }
+        }
+    }
+}
+
+const std::vector<opt::Pass>& opt::PassManager::pipeline() const {
+    return passes;
+}
+
+std::vector<std::string> opt::PassManager::pass_names() {
+    std::vector<std::string> res;
+    for (const auto& entry: pass_table()) res.push_back(entry.name);
+    return res;
+}
+
+void opt::PassManager::run(ir::Program& program) {
+    if (passes.empty()) return;
+    if (options.verify) {
+        auto err = verify(program);
+        if (!err.empty()) {
+            // not an error of a pass, the passes still run but their output is not checked against it
+            std::cerr << "IR verification failed before optimization, not verifying the passes: " << err << std::endl;
+            options.verify = false;
+        }
+    }
+
+    if (options.time_passes) {
+        fprintf(stderr, "%-10s %10s %10s %10s %8s %8s\n", "pass", "time(ms)", "insts", "after", "delta", "changes");
+    }
+    double total_ms = 0;
+    int start_cnt = inst_count(program);
+    for (const auto& pass: passes) {
+        int before = inst_count(program);
+        auto t0 = std::chrono::steady_clock::now();
+        int changes = pass.run(program);
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        total_ms += ms;
+        int after = inst_count(program);
+        if (options.time_passes) {
+            fprintf(stderr, "%-10s %10.3f %10d %10d %+8d %8d\n", pass.name.c_str(), ms, before, after, after - before, changes);
+        }
+
+        if (options.verify) {
+            auto err = verify(program);
+            if (!err.empty()) {
+                std::cerr << "IR verification failed after pass " << pass.name << ": " << err << std::endl;
+                assert(0 && "IR verification failed");
+            }
+        }
+    }
+    if (options.time_passes) {
+        int end_cnt = inst_count(program);
+        fprintf(stderr, "%-10s %10.3f %10d %10d %+8d\n", "total", total_ms, start_cnt, end_cnt, end_cnt - start_cnt);
+    }
+}
@@ -0,0 +1,28 @@
+#include "opt/profile.h"
+#include "json/json.h"
+
+#include<fstream>
+
+bool opt::Profile::load(const std::string& path) {
+    std::ifstream is(path);
+    if (!is) return false;
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::string err;
+    if (!Json::parseFromStream(builder, is, &root, &err) || !root.isObject() || root["version"].asInt() != 1) return false;
+    functions.clear();
+    for (const auto& func: root["functions"]) {
+        auto& fc = functions[func["name"].asString()];
+        fc.calls = func["calls"].asUInt64();
+        for (const auto& n: func["counts"]) fc.counts.push_back(n.asUInt64());
+        for (const auto& edge: func["gotos"]) {
+            fc.gotos[edge["pc"].asInt()] = {edge["taken"].asUInt64(), edge["not_taken"].asUInt64()};
+        }
+    }
+    return true;
+}
+
+long long opt::Profile::calls(const std::string& name) const {
+    auto it = functions.find(name);
+    return it == functions.end() ? -1 : (long long)it->second.calls;
+}
@@ -0,0 +1,119 @@
+#include "opt/sroa.h"
+#include "opt/ir_util.h"
+
+#include<map>
+#include<set>
+#include<string>
+#include<vector>
+
+using ir::Type;
+using ir::Operand;
+using ir::Operator;
+
+namespace {
+
+int sroa_function(ir::Function& func, const std::set<std::string>& globals) {
+    auto consts = opt::int_constants(func, globals);
+
+    // candidates: alloc'ed once with a small literal size, global arrays are alloc'ed in function global
+    std::map<std::string, int> size;
+    std::set<std::string> rejected;
+    for (auto inst: func.InstVec) {
+        if (inst->op != Operator::alloc || globals.count(inst->des.name)) continue;
+        if (size.count(inst->des.name)) rejected.insert(inst->des.name);
+        size[inst->des.name] = std::stoi(inst->op1.name);
+        if (size[inst->des.name] > opt::max_sroa_size) rejected.insert(inst->des.name);
+    }
+    // any other use than a load/store with a constant index in range, or a memset of a constant count, lets the array escape
+    for (auto inst: func.InstVec) {
+        int idx;
+        if (inst->op == Operator::memset && size.count(inst->op1.name)) {
+            if (!opt::get_int_constant(inst->op2, consts, idx) || idx < 0 || idx > size[inst->op1.name]) rejected.insert(inst->op1.name);
+            continue;
+        }
+        if ((inst->op == Operator::load || inst->op == Operator::store) && size.count(inst->op1.name)) {
+            if (!opt::get_int_constant(inst->op2, consts, idx) || idx < 0 || idx >= size[inst->op1.name]) rejected.insert(inst->op1.name);
+            if (inst->op == Operator::store && inst->des.name == inst->op1.name) rejected.insert(inst->op1.name);
+            continue;
+        }
+        if (inst->op == Operator::alloc) continue;
+        for (const auto& op: opt::uses_of(inst)) {
+            if (size.count(op.name)) rejected.insert(op.name);
+        }
+        auto def = opt::def_of(inst);
+        if (def && size.count(def->name)) rejected.insert(def->name);
+    }
+
+    std::map<std::string, std::vector<Operand>> elems;
+    for (const auto& it: size) {
+        if (rejected.count(it.first)) continue;
+        auto& e = elems[it.first];
+        for (int i = 0; i < it.second; i++) e.push_back(Operand(opt::fresh_name("sroa"), Type::Int));
+    }
+    if (elems.empty()) return 0;
+
+    // replace instructions one for one (an alloc may expand), so goto offsets are fixed by an index map
+    std::vector<ir::Instruction*> res;
+    std::vector<int> new_index(func.InstVec.size() + 1);
+    for (size_t i = 0; i < func.InstVec.size(); i++) {
+        new_index[i] = res.size();
+        auto inst = func.InstVec[i];
+        auto it = elems.find(inst->op1.name);
+        if (inst->op == Operator::alloc && elems.count(inst->des.name)) {
+            bool is_float = inst->des.type == Type::FloatPtr;
+            for (auto& e: elems[inst->des.name]) {
+                e.type = is_float ? Type::Float : Type::Int;
+                auto zero = is_float ? Operand("0.0", Type::FloatLiteral) : Operand("0", Type::IntLiteral);
+                res.push_back(new ir::Instruction(zero, Operand(), e, is_float ? Operator::fdef : Operator::def));
+            }
+            continue;
+        }
+        if (inst->op == Operator::memset && it != elems.end()) {
+            int cnt;
+            opt::get_int_constant(inst->op2, consts, cnt);
+            bool is_float = inst->op1.type == Type::FloatPtr;
+            for (int k = 0; k < cnt; k++) {
+                auto zero = is_float ? Operand("0.0", Type::FloatLiteral) : Operand("0", Type::IntLiteral);
+                res.push_back(new ir::Instruction(zero, Operand(), it->second[k], is_float ? Operator::fmov : Operator::mov));
+            }
+            continue;
+        }
+        if ((inst->op == Operator::load || inst->op == Operator::store) && it != elems.end()) {
+            int idx;
+            opt::get_int_constant(inst->op2, consts, idx);
+            const auto& e = it->second[idx];
+            bool is_float = inst->op1.type == Type::FloatPtr;
+            auto mov = is_float ? Operator::fmov : Operator::mov;
+            if (inst->op == Operator::load) {
+                res.push_back(new ir::Instruction(e, Operand(), inst->des, mov));
+            }
+            else {
+                auto val = inst->des;
+                if (is_float && val.type == Type::IntLiteral) val.type = Type::FloatLiteral;
+                res.push_back(new ir::Instruction(val, Operand(), e, mov));
+            }
+            continue;
+        }
+        res.push_back(inst);
+    }
+    new_index[func.InstVec.size()] = res.size();
+    for (size_t i = 0; i < func.InstVec.size(); i++) {
+        auto inst = func.InstVec[i];
+        if (inst->op != Operator::_goto) continue;
+        int target = new_index[i + opt::goto_offset(inst)];
+        inst->des = Operand(std::to_string(target - new_index[i]), Type::IntLiteral);
+    }
+    func.InstVec = res;
+    return elems.size();
+}
+
+} // namespace
+
+int opt::sroa(ir::Program& program) {
+    auto globals = global_names(program);
+    int total = 0;
+    for (auto& func: program.functions) {
+        total += sroa_function(func, globals);
+    }
+    return total;
+}
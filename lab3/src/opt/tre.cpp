@@ -0,0 +1,141 @@
+#include "opt/tre.h"
+#include "opt/ir_util.h"
+#include "opt/cfg.h"
+
+#include<set>
+#include<string>
+#include<vector>
+#include<cassert>
+
+using ir::Operator;
+using ir::Type;
+
+namespace {
+
+/**
+ * whether the control reaching insts[pos] of bb returns the value of ret without any other effect,
+ * fall-through and unconditional jumps are followed
+ * @param ret: the result of the tail call, null for a void call
+ */
+bool returns_value(const opt::BasicBlock* bb, size_t pos, const ir::Operand& ret, const std::set<std::string>& globals) {
+    auto val = ret;
+    // each block is visited at most once, an empty loop never returns
+    std::set<const opt::BasicBlock*> visited;
+    while (bb && visited.insert(bb).second) {
+        for (; pos < bb->insts.size(); pos++) {
+            auto inst = bb->insts[pos];
+            switch (inst->op) {
+                case Operator::__unuse__:
+                    break;
+                case Operator::mov: case Operator::def: case Operator::fmov: case Operator::fdef:
+                    if (!opt::is_var(val) || inst->op1.name != val.name || globals.count(inst->des.name)) return false;
+                    val = inst->des;
+                    break;
+                case Operator::_return:
+                    if (!opt::is_var(val)) return !opt::is_var(inst->op1) && inst->op1.type == Type::null;
+                    return inst->op1.name == val.name;
+                case Operator::_goto:
+                    if (opt::is_var(inst->op1)) return false;
+                    break;
+                default:
+                    return false;
+            }
+        }
+        bb = bb->jump_target ? bb->jump_target : bb->fall_through;
+        pos = 0;
+    }
+    return false;
+}
+
+int tre(ir::Function& func, const std::set<std::string>& globals) {
+    opt::CFG cfg(&func);
+
+    // the loop starts after the allocs, which all move to a new entry block so that a call to the loop reuses
+    // the arrays of the first call instead of allocating them on every iteration
+    auto entry = cfg.blocks[0];
+    auto prologue = cfg.insert_block_before(entry);
+    prologue->fall_through = entry;
+    std::set<std::string> own;
+    for (auto bb: cfg.blocks) {
+        if (bb == prologue) continue;
+        std::vector<ir::Instruction*> rest;
+        for (auto inst: bb->insts) {
+            if (inst->op == Operator::alloc) {
+                prologue->insts.push_back(inst);
+                own.insert(inst->des.name);
+            } else {
+                rest.push_back(inst);
+            }
+        }
+        bb->insts = rest;
+    }
+    // the pointers into the own arrays, an argument among them would make the next level overwrite the array
+    // it reads, as all levels now share one
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (auto bb: cfg.blocks) {
+            for (auto inst: bb->insts) {
+                if (!opt::is_var(inst->des) || (inst->des.type != Type::IntPtr && inst->des.type != Type::FloatPtr)) continue;
+                if (own.count(inst->des.name) || !(own.count(inst->op1.name) || own.count(inst->op2.name))) continue;
+                own.insert(inst->des.name);
+                changed = true;
+            }
+        }
+    }
+
+    std::set<std::string> params;
+    for (const auto& para: func.ParameterList) params.insert(para.name);
+
+    int cnt = 0;
+    for (auto bb: cfg.blocks) {
+        for (size_t k = 0; k < bb->insts.size(); k++) {
+            auto inst = bb->insts[k];
+            if (inst->op != Operator::call || inst->op1.name != func.name) continue;
+            if (!returns_value(bb, k + 1, inst->des, globals)) continue;
+
+            auto call = dynamic_cast<ir::CallInst*>(inst);
+            assert(call && call->argumentList.size() == func.ParameterList.size());
+            bool passes_own = false;
+            for (const auto& arg: call->argumentList) passes_own |= opt::is_var(arg) && own.count(arg.name);
+            if (passes_own) continue;
+            // parameters are assigned in order, an argument reading a parameter is saved to a temporary first
+            std::vector<ir::Instruction*> assign;
+            std::vector<ir::Operand> args = call->argumentList;
+            for (auto& arg: args) {
+                if (!opt::is_var(arg) || !params.count(arg.name)) continue;
+                ir::Operand tmp(opt::fresh_name("tre"), arg.type);
+                if (arg.type == Type::Int) assign.push_back(new ir::Instruction(arg, ir::Operand(), tmp, Operator::def));
+                else if (arg.type == Type::Float) assign.push_back(new ir::Instruction(arg, ir::Operand(), tmp, Operator::fdef));
+                else assign.push_back(new ir::Instruction(arg, ir::Operand("0", Type::IntLiteral), tmp, Operator::getptr));
+                arg = tmp;
+            }
+            for (size_t i = 0; i < args.size(); i++) {
+                const auto& para = func.ParameterList[i];
+                if (para.type == Type::Int) assign.push_back(new ir::Instruction(args[i], ir::Operand(), para, Operator::mov));
+                else if (para.type == Type::Float) assign.push_back(new ir::Instruction(args[i], ir::Operand(), para, Operator::fmov));
+                else assign.push_back(new ir::Instruction(args[i], ir::Operand("0", Type::IntLiteral), para, Operator::getptr));
+            }
+            assign.push_back(new ir::Instruction(ir::Operand("null", Type::null), ir::Operand(), ir::Operand(), Operator::_goto));
+
+            bb->insts.resize(k);
+            bb->insts.insert(bb->insts.end(), assign.begin(), assign.end());
+            bb->jump_target = entry;
+            bb->fall_through = nullptr;
+            cnt++;
+            break;
+        }
+    }
+    if (cnt) cfg.linearize();
+    return cnt;
+}
+
+} // namespace
+
+int opt::tre(ir::Program& program) {
+    auto globals = global_names(program);
+    int total = 0;
+    for (auto& func: program.functions) {
+        total += ::tre(func, globals);
+    }
+    return total;
+}
@@ -0,0 +1,359 @@
+#include "opt/unroll.h"
+#include "opt/ir_util.h"
+#include "opt/cfg.h"
+#include "opt/loop.h"
+#include "opt/liveness.h"
+
+#include<map>
+#include<set>
+#include<string>
+#include<vector>
+#include<cstdint>
+#include<algorithm>
+
+using ir::Type;
+using ir::Operand;
+using ir::Operator;
+
+namespace {
+
+// max instruction count of a fully unrolled loop
+const int max_full_unroll_size = 128;
+// max instruction count of the unrolled body of a partially unrolled loop
+const int max_partial_unroll_size = 256;
+
+// the loop continues while `iv op bound` holds
+struct LoopBound {
+    std::string iv;
+    int step;
+    Operator op;                                // one of lss, leq, gtr, geq
+    Operand bound;
+};
+
+Operator swap_cmp(Operator op) {
+    switch (op) {
+        case Operator::lss: return Operator::gtr;
+        case Operator::leq: return Operator::geq;
+        case Operator::gtr: return Operator::lss;
+        case Operator::geq: return Operator::leq;
+        default: return op;
+    }
+}
+
+Operator negate_cmp(Operator op) {
+    switch (op) {
+        case Operator::lss: return Operator::geq;
+        case Operator::leq: return Operator::gtr;
+        case Operator::gtr: return Operator::leq;
+        case Operator::geq: return Operator::lss;
+        default: return op;
+    }
+}
+
+bool is_int_cmp(Operator op) {
+    return op == Operator::lss || op == Operator::leq || op == Operator::gtr || op == Operator::geq;
+}
+
+struct LoopUnroller {
+    opt::CFG& cfg;
+    opt::Loop* loop;
+    const std::set<std::string>& globals;
+    const std::map<std::string, int>& consts;
+    int factor;
+
+    opt::BasicBlock* header = nullptr;
+    opt::BasicBlock* body = nullptr;
+    opt::BasicBlock* exit = nullptr;
+    std::map<std::string, int> def_cnt;
+
+    // decided by plan()
+    LoopBound lb;
+    int size = 0;                               // instruction count of the body without its jump
+    bool full = false;                          // fully unrolled to trip copies of the body
+    long long trip = 0;
+    long long k = 0;                            // (factor - 1) * step
+    long long limit = 0;                        // bound - k, if bound is a constant
+
+    LoopUnroller(opt::CFG& c, opt::Loop* l, const std::set<std::string>& g, const std::map<std::string, int>& k, int f)
+        : cfg(c), loop(l), globals(g), consts(k), factor(f) {}
+
+    // the header ends with `if v goto exit` and falls through to the body, which jumps back to the header
+    bool match_shape() {
+        if (loop->blocks.size() != 2 || loop->latches.size() != 1) return false;
+        header = loop->header;
+        body = loop->latches[0];
+        auto term = header->terminator();
+        if (!term || term->op != Operator::_goto || !opt::is_var(term->op1)) return false;
+        if (header->fall_through != body || loop->contains(header->jump_target)) return false;
+        exit = header->jump_target;
+        auto bterm = body->terminator();
+        if (!bterm || bterm->op != Operator::_goto || opt::is_var(bterm->op1) || body->jump_target != header) return false;
+        for (auto bb: {header, body}) {
+            for (auto inst: bb->insts) {
+                // the copies of an alloc would take more stack space in the backend
+                if (inst->op == Operator::alloc || inst->op == Operator::_return) return false;
+                auto def = opt::def_of(inst);
+                if (def) def_cnt[def->name]++;
+            }
+        }
+        return true;
+    }
+
+    ir::Instruction* def_in(opt::BasicBlock* bb, const std::string& var) const {
+        for (auto inst: bb->insts) {
+            auto def = opt::def_of(inst);
+            if (def && def->name == var) return inst;
+        }
+        return nullptr;
+    }
+
+    bool has_call() const {
+        for (auto inst: body->insts) {
+            if (inst->op == Operator::call && !opt::is_lib_call(inst)) return true;
+        }
+        return false;
+    }
+
+    bool find_bound(LoopBound& res) const {
+        auto v = header->terminator()->op1;
+        // exit if v, so continue while !v
+        auto vdef = def_in(header, v.name);
+        if (!vdef || def_cnt.at(v.name) != 1) return false;
+        ir::Instruction* cmp = nullptr;
+        bool negate = true;
+        if (vdef->op == Operator::_not && opt::is_var(vdef->op1)) {
+            cmp = def_in(header, vdef->op1.name);
+            negate = false;
+            if (!cmp || def_cnt.at(vdef->op1.name) != 1) return false;
+        }
+        else {
+            cmp = vdef;
+        }
+        if (!is_int_cmp(cmp->op) || cmp->op1.type == Type::Float || cmp->op2.type == Type::Float) return false;
+        Operator op = negate ? negate_cmp(cmp->op) : cmp->op;
+
+        // iv op bound, or bound op iv
+        Operand iv = cmp->op1, bound = cmp->op2;
+        if (!find_iv(iv.name, res.step)) {
+            std::swap(iv, bound);
+            op = swap_cmp(op);
+            if (!find_iv(iv.name, res.step)) return false;
+        }
+        int c;
+        if (opt::get_int_constant(bound, consts, c)) {
+            bound = Operand(std::to_string(c), Type::IntLiteral);
+        }
+        else if (!opt::is_var(bound) || def_cnt.count(bound.name) || (globals.count(bound.name) && has_call())) {
+            return false;
+        }
+        // the test must be able to fail while iv moves
+        bool up = op == Operator::lss || op == Operator::leq;
+        if (res.step == 0 || up != (res.step > 0)) return false;
+        res.iv = iv.name;
+        res.op = op;
+        res.bound = bound;
+        return true;
+    }
+
+    // iv is written once in the loop, by iv = tmp, tmp = iv + step, both in the body
+    bool find_iv(const std::string& iv, int& step) const {
+        if (iv.empty() || !def_cnt.count(iv) || def_cnt.at(iv) != 1 || globals.count(iv)) return false;
+        auto inst = def_in(body, iv);
+        if (!inst || (inst->op != Operator::def && inst->op != Operator::mov) || inst->des.type != Type::Int) return false;
+        const auto& tmp = inst->op1;
+        if (!opt::is_var(tmp) || !def_cnt.count(tmp.name) || def_cnt.at(tmp.name) != 1) return false;
+        auto tinst = def_in(body, tmp.name);
+        auto& insts = body->insts;
+        if (!tinst || std::find(insts.begin(), insts.end(), tinst) > std::find(insts.begin(), insts.end(), inst)) return false;
+        int c;
+        switch (tinst->op) {
+            case Operator::add:
+                if (tinst->op1.name == iv && opt::get_int_constant(tinst->op2, consts, c)) step = c;
+                else if (tinst->op2.name == iv && opt::get_int_constant(tinst->op1, consts, c)) step = c;
+                else return false;
+                return true;
+            case Operator::addi:
+            case Operator::sub:
+            case Operator::subi:
+                if (tinst->op1.name != iv || !opt::get_int_constant(tinst->op2, consts, c)) return false;
+                step = tinst->op == Operator::addi ? c : -c;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // the value of iv when the loop is entered, if it is a constant
+    bool entry_value(const std::string& iv, int& val) const {
+        opt::BasicBlock* pre = nullptr;
+        for (auto p: header->preds) {
+            if (loop->contains(p)) continue;
+            if (pre) return false;
+            pre = p;
+        }
+        if (!pre) return false;
+        for (auto it = pre->insts.rbegin(); it != pre->insts.rend(); ++it) {
+            auto def = opt::def_of(*it);
+            if (!def || def->name != iv) continue;
+            return ((*it)->op == Operator::def || (*it)->op == Operator::mov) && opt::get_int_constant((*it)->op1, consts, val);
+        }
+        return false;
+    }
+
+    static long long trip_count(int init, int step, Operator op, int bound) {
+        long long n = 0;
+        switch (op) {
+            case Operator::lss: n = init < bound ? ((long long)bound - init + step - 1) / step : 0; break;
+            case Operator::leq: n = init <= bound ? ((long long)bound - init) / step + 1 : 0; break;
+            case Operator::gtr: n = init > bound ? ((long long)init - bound - step - 1) / -step : 0; break;
+            case Operator::geq: n = init >= bound ? ((long long)init - bound) / -step + 1 : 0; break;
+            default: break;
+        }
+        return n;
+    }
+
+    // the header only computes the exit test, so it may be skipped between body copies, 
+    // with check_exit it may also be dropped after the last one
+    bool header_is_test_only(const opt::Liveness& live, bool check_exit) const {
+        for (auto inst: header->insts) {
+            if (inst->op == Operator::_goto) continue;
+            if (inst->op == Operator::call || inst->op == Operator::store || inst->op == Operator::memset) return false;
+            auto def = opt::def_of(inst);
+            if (!def || globals.count(def->name) || live.live_in[body->index].count(def->name)) return false;
+            if (check_exit && live.live_in[exit->index].count(def->name)) return false;
+        }
+        return true;
+    }
+
+    std::vector<ir::Instruction*> body_copies(int n) const {
+        std::vector<ir::Instruction*> res;
+        for (int k = 0; k < n; k++) {
+            for (size_t i = 0; i + 1 < body->insts.size(); i++) res.push_back(opt::clone(body->insts[i]));
+        }
+        return res;
+    }
+
+    // whether and how the loop is unrolled, live must describe the CFG before any loop is changed
+    bool plan(const opt::Liveness& live) {
+        if (!match_shape() || !find_bound(lb)) return false;
+        size = body->insts.size() - 1;
+
+        int init;
+        if (entry_value(lb.iv, init) && !opt::is_var(lb.bound)) {
+            auto n = trip_count(init, lb.step, lb.op, std::stoi(lb.bound.name));
+            if (n * size <= max_full_unroll_size && header_is_test_only(live, true)) {
+                full = true;
+                trip = n;
+                return true;
+            }
+        }
+
+        if (size * factor > max_partial_unroll_size || !header_is_test_only(live, false)) return false;
+        // factor more iterations run while iv op bound - (factor - 1) * step holds, iv never passes bound on the way;
+        // the limit must not wrap, a constant one is checked here, a variable one before the loop
+        k = (long long)(factor - 1) * lb.step;
+        if (k < INT32_MIN || k > INT32_MAX) return false;
+        if (!opt::is_var(lb.bound)) {
+            limit = std::stoll(lb.bound.name) - k;
+            if (limit < INT32_MIN || limit > INT32_MAX) return false;
+        }
+        return true;
+    }
+
+    // unroll the planned loop, the caller linearizes the CFG
+    void apply() {
+        if (full) {
+            auto pre = opt::insert_preheader(cfg, loop);
+            auto copies = body_copies(trip);
+            pre->insts.insert(pre->insts.end(), copies.begin(), copies.end());
+            // not exit, which is a preheader now if it is the header of a loop unrolled before
+            pre->fall_through = header->jump_target;
+            cfg.blocks.erase(std::find(cfg.blocks.begin(), cfg.blocks.end(), header));
+            cfg.blocks.erase(std::find(cfg.blocks.begin(), cfg.blocks.end(), body));
+            delete header;
+            delete body;
+            return;
+        }
+
+        // chk:  g = bound - k; if bound <(>) INT_MIN(MAX) + k goto header
+        // pre:  if !(iv op g) goto header
+        // ub:   body * factor; goto pre
+        bool up = lb.step > 0;
+        Operand g1(opt::fresh_name("unroll"), Type::Int), g2(opt::fresh_name("unroll"), Type::Int), g3(opt::fresh_name("unroll"), Type::Int);
+        opt::BasicBlock* chk = nullptr;
+        if (!opt::is_var(lb.bound)) {
+            g1 = Operand(std::to_string(limit), Type::IntLiteral);
+        }
+        else {
+            chk = opt::insert_preheader(cfg, loop);
+            Operand wraps(opt::fresh_name("unroll"), Type::Int);
+            Operand edge(std::to_string(up ? INT32_MIN + k : INT32_MAX + k), Type::IntLiteral);
+            chk->insts.push_back(new ir::Instruction(lb.bound, Operand(std::to_string(-k), Type::IntLiteral), g1, Operator::addi));
+            chk->insts.push_back(new ir::Instruction(lb.bound, edge, wraps, up ? Operator::lss : Operator::gtr));
+            chk->insts.push_back(new ir::Instruction(wraps, Operand(), Operand(), Operator::_goto));
+        }
+        auto pre = opt::insert_preheader(cfg, loop);
+        if (chk) chk->jump_target = header;
+        auto ub = cfg.insert_block_before(header);
+        pre->insts.push_back(new ir::Instruction(Operand(lb.iv, Type::Int), g1, g2, lb.op));
+        pre->insts.push_back(new ir::Instruction(g2, Operand(), g3, Operator::_not));
+        pre->insts.push_back(new ir::Instruction(g3, Operand(), Operand(), Operator::_goto));
+        pre->jump_target = header;
+        pre->fall_through = ub;
+        ub->insts = body_copies(factor);
+        ub->insts.push_back(new ir::Instruction(Operand("null", Type::null), Operand(), Operand(), Operator::_goto));
+        ub->jump_target = pre;
+    }
+};
+
+// like licm, every loop without a changed loop inside is handled in a round sharing the analyses,
+// the loops made by unrolling are not pending, so they are never unrolled again
+int unroll_function(ir::Function& func, const std::set<std::string>& globals, int factor) {
+    int total = 0;
+    bool first_round = true;
+    std::set<ir::Instruction*> pending;             // identify a loop by the first instruction of its header
+    while (first_round || !pending.empty()) {
+        opt::CFG cfg(&func);
+        opt::DomTree dom(cfg);
+        opt::LoopInfo loops(cfg, dom);
+        if (loops.loops.empty()) break;
+        opt::Liveness live(cfg, globals);
+        auto consts = opt::int_constants(func, globals);
+
+        std::set<opt::Loop*> blocked;               // loops containing a changed loop
+        std::set<ir::Instruction*> next;
+        std::vector<LoopUnroller> planned;
+        for (auto loop: loops.loops) {
+            auto header = loop->header->insts.front();
+            if (!first_round && !pending.count(header)) continue;
+            if (blocked.count(loop)) {
+                next.insert(header);
+                continue;
+            }
+            LoopUnroller unroller(cfg, loop, globals, consts, factor);
+            if (!unroller.plan(live)) continue;
+            planned.push_back(unroller);
+            for (auto p = loop->parent; p; p = p->parent) blocked.insert(p);
+        }
+        if (planned.empty()) break;
+
+        for (auto& unroller: planned) unroller.apply();
+        cfg.linearize();
+        total += planned.size();
+        pending = next;
+        first_round = false;
+    }
+    return total;
+}
+
+} // namespace
+
+int opt::unroll(ir::Program& program, int factor) {
+    if (factor < 2) return 0;
+    auto globals = global_names(program);
+    int total = 0;
+    for (auto& func: program.functions) {
+        total += unroll_function(func, globals, factor);
+    }
+    return total;
+}
@@ -0,0 +1,86 @@
+#include "opt/verifier.h"
+#include "opt/ir_util.h"
+#include "front/semantic.h"
+
+#include<map>
+#include<string>
+
+using ir::Type;
+using ir::Operator;
+
+namespace {
+
+bool is_ptr(const ir::Operand& op) {
+    return op.type == Type::IntPtr || op.type == Type::FloatPtr;
+}
+
+std::string where(const ir::Function& func, size_t pc, const ir::Instruction* inst) {
+    return func.name + "[" + std::to_string(pc) + "] " + inst->draw() + ": ";
+}
+
+std::string verify_function(const ir::Function& func, const std::map<std::string, const ir::Function*>& funcs) {
+    const auto& insts = func.InstVec;
+    std::map<std::string, Type> types;
+    for (const auto& para: func.ParameterList) types[para.name] = para.type;
+
+    for (size_t pc = 0; pc < insts.size(); pc++) {
+        auto inst = insts[pc];
+        if (!inst) return func.name + "[" + std::to_string(pc) + "]: null instruction";
+
+        std::vector<ir::Operand> ops = opt::uses_of(inst);
+        if (auto def = opt::def_of(inst)) ops.push_back(*def);
+        for (const auto& op: ops) {
+            auto it = types.find(op.name);
+            if (it == types.end()) types[op.name] = op.type;
+            else if (it->second != op.type) return where(func, pc, inst) + op.name + " is used as " + ir::toString(op.type) + " and " + ir::toString(it->second);
+        }
+
+        switch (inst->op) {
+            case Operator::_goto: {
+                if (inst->des.type != Type::IntLiteral) return where(func, pc, inst) + "goto offset should be an IntLiteral";
+                int target = pc + opt::goto_offset(inst);
+                if (target < 0 || target > static_cast<int>(insts.size())) return where(func, pc, inst) + "goto out of function";
+            } break;
+            case Operator::call: {
+                auto callinst = dynamic_cast<const ir::CallInst*>(inst);
+                if (!callinst) return where(func, pc, inst) + "call should be a ir::CallInst";
+                auto it = funcs.find(inst->op1.name);
+                if (it == funcs.end()) return where(func, pc, inst) + "call of undefined function";
+                if (it->second->ParameterList.size() != callinst->argumentList.size()) return where(func, pc, inst) + "argument count mismatch";
+                if (it->second->returnType != Type::null && inst->des.type != it->second->returnType) return where(func, pc, inst) + "return type mismatch";
+            } break;
+            case Operator::alloc:
+                if (inst->op1.type != Type::IntLiteral || !is_ptr(inst->des)) return where(func, pc, inst) + "alloc should be `alloc ptr, literal`";
+                break;
+            case Operator::load: case Operator::store: case Operator::getptr: case Operator::memset:
+                if (!is_ptr(inst->op1)) return where(func, pc, inst) + "op1 should be a pointer";
+                if (inst->op2.type != Type::Int && inst->op2.type != Type::IntLiteral) return where(func, pc, inst) + "op2 should be an integer";
+                break;
+            default:
+                break;
+        }
+    }
+
+    // the frontend leaves a __unuse__ label after an if-else whose branches both return
+    size_t end = insts.size();
+    while (end > 0 && insts[end - 1]->op == Operator::__unuse__) end--;
+    if (end == 0) return func.name + ": empty function";
+    auto last = insts[end - 1];
+    if (last->op != Operator::_return && !(last->op == Operator::_goto && !opt::is_var(last->op1))) {
+        return func.name + ": control reaches the end of function";
+    }
+    return "";
+}
+
+} // namespace
+
+std::string opt::verify(const ir::Program& program) {
+    std::map<std::string, const ir::Function*> funcs;
+    for (const auto& it: *frontend::get_lib_funcs()) funcs[it.first] = it.second;
+    for (const auto& func: program.functions) funcs[func.name] = &func;
+    for (const auto& func: program.functions) {
+        auto err = verify_function(func, funcs);
+        if (!err.empty()) return err;
+    }
+    return "";
+}
@@ -3,22 +3,34 @@
 #include"tools/ir_executor.h"
 
 #include<stdio.h>
+#include<csignal>
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
 #include<cassert>
 #include<iostream>
 
 #define TODO assert(0 && "TODO");
-#define DEBUG_EXEC_BRIEF  1
-#define DEBUG_EXEC_DETAIL 0
 #define IS_INT_OPERAND(operand) (operand.type == Type::Int || operand.type == Type::IntLiteral)
 #define IS_FLOAT_OPERAND(operand) (operand.type == Type::Float || operand.type == Type::FloatLiteral)
 
 
 using ir::Type;
 
+namespace {
+
+// the executor whose trace ring is dumped when the process is killed by a failed assert or a fault
+const ir::Executor* ring_owner = nullptr;
+
+void dump_ring_on_signal(int sig) {
+    if (ring_owner) ring_owner->dump_trace_ring(std::cerr);
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
+
+} // namespace
+
 int ir::eval_int(std::string s) {
-#if (DEBUG_EXEC_DETAIL)
-    std::cout << "\teval_int: " << s << std::endl;
-#endif
     if (s.size() >= 2 && (s.substr(0,2)=="0b" || s.substr(0,2)=="0B")) {
         return std::stoi(s.substr(2, s.size()-2), nullptr, 2); 
     }
@@ -33,124 +45,193 @@ int ir::eval_int(std::string s) {
     }
 }
 
-ir::Context::Context(const ir::Function* pf): pc(0), retval_addr(nullptr), mem(std::map<std::string, Value>()), pfunc(pf) {} 
+ir::Context::Context(const PreparedFunction* pf, size_t base): pc(0), base(base), retval(), pfunc(pf->pfunc), prepared(pf) {} 
 
-ir::Executor::Executor(const ir::Program* pp, std::ostream& os): out(os), program(pp), global_vars(std::map<std::string, Value>()), cur_ctx(nullptr), cxt_stack(std::stack<Context*>()) {}
+ir::Executor::Executor(const ir::Program* pp, std::ostream& os): out(os), program(pp), global_vars(), stack(), stack_top(0), cur_ctx(nullptr), cxt_stack() {}
 
-ir::Value ir::Executor::find_src_operand(Operand op) {
-#if (DEBUG_EXEC_DETAIL)
-    std::cout << "\tin find_src_operand(" << toString(op.type) << " " << op.name  << ")";
-#endif
-    ir::Value retval;
-    
+ir::Slot ir::Executor::resolve(const Operand& op, PreparedFunction& pf, std::map<std::string, int>& locals) {
+    Slot slot;
     if (op.type == Type::IntLiteral) {
-        return {Type::Int, eval_int(op.name)};
+        slot.kind = Slot::imm;
+        slot.val.t = Type::Int;
+        slot.val._val.ival = eval_int(op.name);
+        return slot;
     }
     else if (op.type == Type::FloatLiteral) {
-        retval.t = Type::Float;
-        retval._val.fval = (float)std::atof(op.name.c_str());
-        return retval;
-    }
-
-    auto iter = cur_ctx->mem.find(op.name);
-    if (iter == cur_ctx->mem.end()) {
-        iter = global_vars.find(op.name);
-        assert(iter != global_vars.end() && "can not find the arguement in current conxtext or global variables");
-    } 
-    retval = iter->second;
-    assert(retval.t == op.type && "type not match");
-#if (DEBUG_EXEC_DETAIL)
-    std::cout << ", value = ";
-    switch (retval.t) {
-    case Type::Int:
-    case Type::IntLiteral:
-        std::cout << retval._val.ival << std::endl;
-    break;
-    case Type::Float:
-    case Type::FloatLiteral:
-        std::cout << retval._val.fval << std::endl;
-    break;
-    default:
-        std::cout << retval._val.iptr << std::endl;
-        break;
+        slot.kind = Slot::imm;
+        slot.val.t = Type::Float;
+        slot.val._val.fval = (float)std::atof(op.name.c_str());
+        return slot;
     }
-#endif
-    return retval;      
-}
-
-ir::Value* ir::Executor::get_des_operand(Operand op) {
-#if (DEBUG_EXEC_DETAIL)
-    std::cout << "\tin get_des_operand(" << toString(op.type) << " " << op.name  << ")";
-#endif
-    ir::Value* retval = nullptr;
-    auto iter = cur_ctx->mem.find(op.name);
-    if (iter != cur_ctx->mem.end()) {                   // find the operand in current context
-        retval = &iter->second;
-    }
-    else {
-        iter = global_vars.find(op.name);
-        if (iter != global_vars.end()) {               // find the operand in global variable
-            retval = &iter->second;
-        }
-        else {                                              // both not, then create a new one
-#if (DEBUG_EXEC_DETAIL)
-    std::cout << ", new des (" << toString(op.type) << " " << op.name  << ")";
-#endif
-            cur_ctx->mem.insert({op.name, {op.type, 0}});
-            retval = &cur_ctx->mem.find(op.name)->second;
-        }
+    else if (op.type == Type::null) {
+        return slot;
     }
 
-#if (DEBUG_EXEC_DETAIL)
-    std::cout << ", value = ";
-    switch (retval->t) {
-    case Type::Int:
-    case Type::IntLiteral:
-        std::cout << retval->_val.ival << std::endl;
-    break;
-    case Type::Float:
-    case Type::FloatLiteral:
-        std::cout << retval->_val.fval << std::endl;
-    break;
-    default:
-        std::cout << retval->_val.iptr << std::endl;
-        break;
+    // a local variable (or parameter) first, then a global one, otherwise it is a new local variable
+    auto iter = locals.find(op.name);
+    if (iter == locals.end()) {
+        auto giter = global_index.find(op.name);
+        if (giter != global_index.end()) {
+            assert(global_vars[giter->second].t == op.type && "type not match");
+            slot.kind = Slot::global;
+            slot.index = giter->second;
+            return slot;
+        }
+        iter = locals.insert({op.name, (int)pf.frame.size()}).first;
+        pf.frame.push_back({op.type, 0});
     }
-#endif
-    return retval;
+    assert(pf.frame[iter->second].t == op.type && "type not match");
+    slot.kind = Slot::local;
+    slot.index = iter->second;
+    return slot;
 }
 
-int ir::Executor::run() {
+void ir::Executor::prepare() {
     // init global variables
     for(const auto& gte: program->globalVal) {
-        std::pair<std::string, Value> entry = {gte.val.name, {gte.val.type, 0}};
+        Value val = {gte.val.type, 0};
         if (gte.maxlen) {
+            // global variable need to init as 0
             if (gte.val.type == Type::IntPtr) {
-                entry.second._val.iptr = new int[gte.maxlen];
-                // global variable need to init as 0
-                for (size_t i = 0; i < gte.maxlen; i++) {
-                    entry.second._val.iptr[i] = 0;
-                }
-                
+                val._val.iptr = new int[gte.maxlen]();
             }
             else if (gte.val.type == Type::FloatPtr) {
-                entry.second._val.fptr = new float[gte.maxlen];
-                // global variable need to init as 0
-                for (size_t i = 0; i < gte.maxlen; i++) {
-                    entry.second._val.fptr[i] = 0;
-                }
+                val._val.fptr = new float[gte.maxlen]();
             }
             else {
                 assert(0 && "wrong global value type with maxlen > 0");
             }
         }
-        global_vars.insert(entry);
+        global_index[gte.val.name] = global_vars.size();
+        global_vars.push_back(val);
+    }
+
+    std::map<std::string, int> func_index;
+    for (size_t fi = 0; fi < program->functions.size(); fi++) {
+        func_index[program->functions[fi].name] = fi;
+    }
+
+    functions.resize(program->functions.size());
+    for (size_t fi = 0; fi < program->functions.size(); fi++) {
+        const auto& func = program->functions[fi];
+        auto& pf = functions[fi];
+        pf.pfunc = &func;
+        std::map<std::string, int> locals;
+        for (const auto& para: func.ParameterList) {
+            locals[para.name] = pf.frame.size();
+            pf.params.push_back(pf.frame.size());
+            pf.frame.push_back({para.type, 0});
+        }
+
+        for (size_t pc = 0; pc < func.InstVec.size(); pc++) {
+            auto inst = func.InstVec[pc];
+            PreparedInst pi;
+            pi.op = inst->op;
+            pi.inst = inst;
+            switch (inst->op) {
+                case Operator::call: {
+                    auto callinst = dynamic_cast<const CallInst*>(inst);
+                    assert(callinst && "call should be a ir::CallInst");
+                    for (const auto& arg: callinst->argumentList) {
+                        pi.args.push_back(resolve(arg, pf, locals));
+                    }
+                    pi.des = resolve(inst->des, pf, locals);
+                    if (frontend::get_lib_funcs()->count(inst->op1.name)) break;
+
+                    auto iter = func_index.find(inst->op1.name);
+                    assert(iter != func_index.end() && "could not find the function in ir::Program");
+                    pi.callee = iter->second;
+                    const auto& callee = program->functions[pi.callee];
+                    // return type checking
+                    assert(callee.returnType == Type::null || inst->des.type == callee.returnType);
+                    // type checking
+                    assert(callee.ParameterList.size() == callinst->argumentList.size() && "callinst's arguement list should match function's parameter list");
+                    for (size_t i = 0; i < callee.ParameterList.size(); i++) {
+                        auto para_type = callee.ParameterList[i].type;
+                        switch (callinst->argumentList[i].type) {
+                        case Type::Int:
+                        case Type::IntLiteral:
+                            assert(para_type == Type::Int);
+                            break;
+                        case Type::Float:
+                        case Type::FloatLiteral:
+                            assert(para_type == Type::Float);
+                            break;                        
+                        // pointers
+                        default:
+                            assert(callinst->argumentList[i].type == para_type);
+                            break;
+                        }
+                        (void)para_type;
+                    }
+                } break;
+                case Operator::_goto: {
+                    if (IS_INT_OPERAND(inst->des)) {
+                        pi.target = pc + eval_int(inst->des.name);
+                    }
+                    else {
+                        assert(0 && "in Operator::goto, des should be a Type::IntLiteral");
+                    }
+                    pi.op1 = resolve(inst->op1, pf, locals);
+                } break;
+                default:
+                    pi.op1 = resolve(inst->op1, pf, locals);
+                    pi.op2 = resolve(inst->op2, pf, locals);
+                    pi.des = resolve(inst->des, pf, locals);
+                    break;
+            }
+            pf.insts.push_back(pi);
+        }
+        translate(pf);
+    }
+}
+
+inline const ir::Value& ir::Executor::src(const Slot& slot, size_t base) const {
+    switch (slot.kind) {
+        case Slot::local: return stack[base + slot.index];
+        case Slot::global: return global_vars[slot.index];
+        default: return slot.val;
+    }
+}
+
+inline const ir::Value& ir::Executor::src(const Slot& slot) const {
+    return src(slot, cur_ctx->base);
+}
+
+inline ir::Value& ir::Executor::des(const Slot& slot) {
+    assert(slot.kind == Slot::local || slot.kind == Slot::global);
+    return slot.kind == Slot::local ? stack[cur_ctx->base + slot.index] : global_vars[slot.index];
+}
+
+void ir::Executor::push_frame(const PreparedFunction& pf, const Slot& retval) {
+    size_t base = stack_top;
+    stack_top += pf.frame.size();
+    if (stack_top > stack.size()) {
+        stack.resize(std::max(stack_top, 2 * stack.size()));
+    }
+    std::copy(pf.frame.begin(), pf.frame.end(), stack.begin() + base);
+    cxt_stack.push_back(Context(&pf, base));
+    cxt_stack.back().retval = retval;
+    cur_ctx = &cxt_stack.back();
+}
+
+int ir::Executor::run() {
+    prepare();
+
+    if (profiling) {
+        profile.resize(functions.size());
+        for (size_t i = 0; i < functions.size(); i++) {
+            profile[i].counts.assign(functions[i].insts.size(), 0);
+            profile[i].taken.assign(functions[i].insts.size(), 0);
+        }
     }
 
     // find main function and set cur_cxt
-    for(const auto& f: program->functions) {
-        if (f.name == "main") {
-            cur_ctx = new Context(&f);
+    stack.resize(1 << 16);
+    for(const auto& pf: functions) {
+        if (pf.pfunc->name == "main") {
+            push_frame(pf, Slot());
+            if (profiling) profile[&pf - functions.data()].calls++;
             break;
         }
     }
@@ -161,147 +242,148 @@ int ir::Executor::run() {
         exit(-1);
     }
 
-    // run
-    Value main_func_retval;
-    cur_ctx->retval_addr = &main_func_retval;
-    cxt_stack.push(cur_ctx);
-    while (cur_ctx) {
-        exec_ir();
+    if (trace.ring) {
+        trace_ring.assign(trace.ring, {-1, 0});
+        ring_pos = 0;
+        ring_owner = this;
+        for (auto sig: {SIGABRT, SIGSEGV, SIGFPE}) std::signal(sig, dump_ring_on_signal);
+    }
+
+    // run, the threaded interpreter neither counts nor traces, so profile and trace with exec_ir
+    if (profiling || trace.enabled || trace.ring) {
+        while (cur_ctx) {
+            exec_ir();
+        }
+    }
+    else {
+        run_threaded();
+    }
+
+    if (trace.ring) {
+        for (auto sig: {SIGABRT, SIGSEGV, SIGFPE}) std::signal(sig, SIG_DFL);
+        ring_owner = nullptr;
     }
     
-    return main_func_retval._val.ival;
+    flush_output();
+    return main_retval._val.ival;
+}
+
+void ir::Executor::trace_inst() {
+    int func = cur_ctx->prepared - functions.data();
+    if (trace.ring) {
+        trace_ring[ring_pos] = {func, (uint32_t)cur_ctx->pc};
+        ring_pos = (ring_pos + 1) % trace.ring;
+    }
+    if (!trace.enabled || (trace.limit && traced > trace.limit)) return;
+    if (trace.limit && traced == trace.limit) {
+        out << "... trace limit of " << trace.limit << " instructions reached\n";
+    }
+    else {
+        out << functions[func].pfunc->name << " " << cur_ctx->pc << ": " << cur_ctx->prepared->insts[cur_ctx->pc].inst->draw() << "\n";
+    }
+    traced++;
+}
+
+void ir::Executor::dump_trace_ring(std::ostream& os) const {
+    os << "last executed instructions:\n";
+    for (size_t i = 0; i < trace_ring.size(); i++) {
+        const auto& entry = trace_ring[(ring_pos + i) % trace_ring.size()];
+        if (entry.first < 0) continue;
+        const auto& pf = functions[entry.first];
+        os << pf.pfunc->name << " " << entry.second << ": " << pf.insts[entry.second].inst->draw() << "\n";
+    }
+    os.flush();
 }
 
 bool ir::Executor::exec_ir(size_t n) {
     while (n--) {
-        assert(cur_ctx->pc < cur_ctx->pfunc->InstVec.size());
-        auto inst = cur_ctx->pfunc->InstVec[cur_ctx->pc];
-#if (DEBUG_EXEC_BRIEF || DEBUG_EXEC_DETAIL)
-    std::cout << cur_ctx->pc << ": " << inst->draw() << std::endl;
-#endif
-        switch (inst->op) {
+        assert(cur_ctx->pc < cur_ctx->prepared->insts.size());
+        const auto& pi = cur_ctx->prepared->insts[cur_ctx->pc];
+        auto inst = pi.inst;
+        FunctionProfile* prof = nullptr;
+        if (profiling) {
+            prof = &profile[cur_ctx->prepared - functions.data()];
+            prof->counts[cur_ctx->pc]++;
+        }
+        if (trace.enabled || trace.ring) trace_inst();
+        switch (pi.op) {
             case Operator::_return: {
-                if (cur_ctx->retval_addr != nullptr) {
+                Value retval;
+                bool is_main = cxt_stack.size() == 1;
+                if (is_main || cur_ctx->retval.kind != Slot::none) {
                     switch (inst->op1.type) {
                     case Type::IntLiteral:
-                        cur_ctx->retval_addr->t = Type::Int;
-                        cur_ctx->retval_addr->_val.ival = eval_int(inst->op1.name);
-                    break;
                     case Type::FloatLiteral:
-                        cur_ctx->retval_addr->t = Type::Float;
-                        cur_ctx->retval_addr->_val.fval = std::atof(inst->op1.name.c_str());
-                    break;
                     case Type::Int:
                     case Type::Float:
-                        *cur_ctx->retval_addr = find_src_operand(inst->op1);
+                        retval = src(pi.op1);
                     break;
                     default:
                         assert(0 && "invalid return value type");
                         break;
                     }
                 }
-                // switch context
-                if (cxt_stack.size()) {        // in main function return
-                    cur_ctx = cxt_stack.top();
-                    cxt_stack.pop();
+                // switch context, the frame is freed for the next call
+                Slot retval_slot = cur_ctx->retval;
+                stack_top = cur_ctx->base;
+                cxt_stack.pop_back();
+                if (is_main) {
+                    main_retval = retval;
+                    cur_ctx = nullptr;
                 }
                 else {
-                    delete cur_ctx;     // FIXME destructor for Context
-                    cur_ctx = nullptr;
+                    cur_ctx = &cxt_stack.back();
+                    if (retval_slot.kind != Slot::none) {
+                        des(retval_slot) = retval;
+                    }
                 }
             } break;
             case Operator::_goto: {
-                int off = 0;
-                if (IS_INT_OPERAND(inst->des)) {
-                    off = find_src_operand(inst->des)._val.ival;
-                }
-                else {
-                    assert(0 && "in Operator::goto, des should be a Type::Int or Type::IntLiteral");
-                }
-
-                if (inst->op1.type == Type::null || find_src_operand(inst->op1)._val.ival) {
-                    cur_ctx->pc += off;
+                if (pi.op1.kind == Slot::none || src(pi.op1)._val.ival) {
+                    if (prof) prof->taken[cur_ctx->pc]++;
+                    cur_ctx->pc = pi.target;
                 }
                 else {
                     cur_ctx->pc++;
                 }
-#if (DEBUG_EXEC_BRIEF || DEBUG_EXEC_DETAIL)
-    std::cout << "\tin goto: pc = " << cur_ctx->pc << std::endl;
-#endif
             } break;
             case Operator::call: {
-                auto callinst = dynamic_cast<CallInst*>(inst); 
-                auto fn = callinst->op1.name;
-
                 // lib functions
                 Value libfunc_retval;
-                if (exec_lib_function(callinst, &libfunc_retval)) {
-                    if (callinst->des.type != Type::null) {
-                        *get_des_operand(inst->des) = libfunc_retval; 
+                if (exec_lib_function(pi, &libfunc_retval)) {
+                    if (inst->des.type != Type::null) {
+                        des(pi.des) = libfunc_retval; 
                     }
                     cur_ctx->pc++;
                     break;
                 }
 
                 // ir::Function
-                Context* cxt = nullptr;
-                for(auto& f: program->functions) {
-                    if (f.name == fn) {
-                        cxt = new Context(&f);
-                    }
-                } 
-
-                // return type checking
-                assert(cxt->pfunc->returnType == Type::null || inst->des.type == cxt->pfunc->returnType);
-                if (cxt->pfunc->returnType != Type::null) {
-                    cxt->retval_addr = get_des_operand(inst->des);
-                }
-
-                if (cxt) {
-                    // type checking
-                    for (size_t i = 0; i < cxt->pfunc->ParameterList.size(); i++) {
-                        auto para = cxt->pfunc->ParameterList[i];
-                        assert(i < callinst->argumentList.size() && "callinst's arguement list should match function's parameter list");
-                        auto arg = callinst->argumentList[i];
-                        switch (arg.type) {
-                        case Type::Int:
-                        case Type::IntLiteral:
-                            assert(para.type == Type::Int);
-                            break;
-                        case Type::Float:
-                        case Type::FloatLiteral:
-                            assert(para.type == Type::Float);
-                            break;                        
-                        // pointers
-                        default:
-                            assert(arg.type == para.type);
-                            break;
-                        }
-                        // pass arguement into new context
-                        cxt->mem.insert({para.name, find_src_operand(arg)});
-                    }
-                    cur_ctx->pc++;
-                    cxt_stack.push(cur_ctx);
-                    cur_ctx = cxt;
-                } 
-                else {
-                    assert(0 && "could not find the function in ir::Program");
+                const auto& callee = functions[pi.callee];
+                if (prof) profile[pi.callee].calls++;
+                size_t caller_base = cur_ctx->base;
+                cur_ctx->pc++;
+                push_frame(callee, callee.pfunc->returnType != Type::null ? pi.des : Slot());
+                // pass arguements into new context
+                for (size_t i = 0; i < pi.args.size(); i++) {
+                    stack[cur_ctx->base + callee.params[i]] = src(pi.args[i], caller_base);
                 }
             } break;
             case Operator::alloc: {
                 int size;
                 if (IS_INT_OPERAND(inst->op1)) {
-                    size = find_src_operand(inst->op1)._val.ival;
+                    size = src(pi.op1)._val.ival;
                 }
                 else {
                     assert(0 && "in Operator::alloc, op1 should be integer");
                 }
                 
+                // zero initialized, as global arrays are
                 if (inst->des.type == Type::IntPtr) {
-                    get_des_operand(inst->des)->_val.iptr = new int[size];
+                    des(pi.des)._val.iptr = new int[size]();
                 }
                 else if (inst->des.type == Type::FloatPtr) {
-                    get_des_operand(inst->des)->_val.fptr = new float[size];
+                    des(pi.des)._val.fptr = new float[size]();
                 }
                 else {
                     assert(0 && "in Operator::alloc, des should be pointer");
@@ -310,17 +392,17 @@ bool ir::Executor::exec_ir(size_t n) {
             case Operator::store: {
                 int off;
                 if (IS_INT_OPERAND(inst->op2)) {
-                    off = find_src_operand(inst->op2)._val.ival;
+                    off = src(pi.op2)._val.ival;
                 }
                 else {
                     assert(0 && "in Operator::store, op2 should be integer");
                 }
 
                 if (IS_INT_OPERAND(inst->des) && inst->op1.type == Type::IntPtr) {
-                    find_src_operand(inst->op1)._val.iptr[off] = find_src_operand(inst->des)._val.ival;
+                    src(pi.op1)._val.iptr[off] = src(pi.des)._val.ival;
                 }
                 else if (IS_FLOAT_OPERAND(inst->des) && inst->op1.type == Type::FloatPtr) {
-                    find_src_operand(inst->op1)._val.fptr[off] = find_src_operand(inst->des)._val.fval;
+                    src(pi.op1)._val.fptr[off] = src(pi.des)._val.fval;
                 }
                 else {
                     assert(0 && "in Operator::store, op1 should be a pointer and des should be the matched type");
@@ -329,17 +411,17 @@ bool ir::Executor::exec_ir(size_t n) {
             case Operator::load: {
                 int off;
                 if (IS_INT_OPERAND(inst->op2)) {
-                    off = find_src_operand(inst->op2)._val.ival;
+                    off = src(pi.op2)._val.ival;
                 }
                 else {
                     assert(0 && "in Operator::load, op2 should be integer");
                 }
 
                 if (IS_INT_OPERAND(inst->des) && inst->op1.type == Type::IntPtr) {
-                    get_des_operand(inst->des)->_val.ival = find_src_operand(inst->op1)._val.iptr[off];
+                    des(pi.des)._val.ival = src(pi.op1)._val.iptr[off];
                 }
                 else if (IS_FLOAT_OPERAND(inst->des) && inst->op1.type == Type::FloatPtr) {
-                    get_des_operand(inst->des)->_val.fval = find_src_operand(inst->op1)._val.fptr[off];
+                    des(pi.des)._val.fval = src(pi.op1)._val.fptr[off];
                 }
                 else {
                     assert(0 && "in Operator::load, op1 should be a pointer and des should be the matched type");
@@ -348,90 +430,94 @@ bool ir::Executor::exec_ir(size_t n) {
             case Operator::getptr: {
                 int off;
                 if (IS_INT_OPERAND(inst->op2)) {
-                    off = find_src_operand(inst->op2)._val.ival;
+                    off = src(pi.op2)._val.ival;
                 }
                 else {
                     assert(0 && "in Operator::getptr, op2 should be integer");
                 }
 
                 if (inst->des.type == Type::IntPtr && inst->op1.type == Type::IntPtr) {
-                    get_des_operand(inst->des)->_val.iptr = find_src_operand(inst->op1)._val.iptr + off;
+                    des(pi.des)._val.iptr = src(pi.op1)._val.iptr + off;
                 }
                 else if (inst->des.type == Type::FloatPtr && inst->op1.type == Type::FloatPtr) {
-                    get_des_operand(inst->des)->_val.fptr = find_src_operand(inst->op1)._val.fptr + off;
+                    des(pi.des)._val.fptr = src(pi.op1)._val.fptr + off;
                 }
                 else {
                     assert(0 && "in Operator::getptr, op1 should be a pointer and des should be the matched type");
                 }
             } break;
+            case Operator::memset: {
+                int cnt;
+                if (IS_INT_OPERAND(inst->op2)) {
+                    cnt = src(pi.op2)._val.ival;
+                }
+                else {
+                    assert(0 && "in Operator::memset, op2 should be integer");
+                }
+
+                if (inst->op1.type == Type::IntPtr) {
+                    std::memset(src(pi.op1)._val.iptr, 0, cnt * sizeof(int));
+                }
+                else if (inst->op1.type == Type::FloatPtr) {
+                    std::memset(src(pi.op1)._val.fptr, 0, cnt * sizeof(float));
+                }
+                else {
+                    assert(0 && "in Operator::memset, op1 should be a pointer");
+                }
+            } break;
             case Operator::mov: 
             case Operator::def: {
                 assert(IS_INT_OPERAND(inst->des));
-                auto pvalue = get_des_operand(inst->des);
+                auto pvalue = &des(pi.des);
                 if (IS_INT_OPERAND(inst->op1)) {
-                    *pvalue = find_src_operand(inst->op1);
+                    *pvalue = src(pi.op1);
                 }
                 else {
                     assert(0 && "in Operator::def[mov], op1 has a wrong type");
                 }
-#if (DEBUG_EXEC_DETAIL)
-                    std::cout << "\tdes operand(" << toString(inst->des.type) << " " << inst->des.name  << "), value = " << pvalue->_val.ival << std::endl;
-#endif
             } break;
             case Operator::_not: {
                 assert(inst->des.type == Type::Int);
-                auto pvalue = get_des_operand(inst->des);
+                auto pvalue = &des(pi.des);
                 int value = 0;
                 if (IS_INT_OPERAND(inst->op1)) {
-                    value = find_src_operand(inst->op1)._val.ival;
+                    value = src(pi.op1)._val.ival;
                 }
                 else {
                     assert(0 && "in Operator::_not, op1 has a wrong type");
                 }
                 pvalue->_val.ival = (value == 0);
-#if (DEBUG_EXEC_DETAIL)
-                    std::cout << "\tdes operand(" << toString(inst->des.type) << " " << inst->des.name  << "), value = " << pvalue->_val.ival << std::endl;
-#endif
             } break;
             case Operator::fdef: 
             case Operator::fmov: {
                 assert(inst->des.type == Type::Float);
-                auto pvalue = get_des_operand(inst->des);
+                auto pvalue = &des(pi.des);
                 if (IS_FLOAT_OPERAND(inst->op1)) {
-                    *pvalue = find_src_operand(inst->op1);
+                    *pvalue = src(pi.op1);
                 }
                 else {
                     assert(0 && "in Operator::fdef[fmov], op1 has a wrong type");
                 }
-#if (DEBUG_EXEC_DETAIL)
-                    std::cout << "\tdes operand(" << toString(inst->des.type) << " " << inst->des.name  << "), value = " << pvalue->_val.ival << std::endl;
-#endif
             } break;
             case Operator::cvt_i2f: {
                 assert(inst->des.type == Type::Float);
-                auto pvalue = get_des_operand(inst->des);
+                auto pvalue = &des(pi.des);
                 if (IS_INT_OPERAND(inst->op1)) {
-                    pvalue->_val.fval = (float)find_src_operand(inst->op1)._val.ival;
+                    pvalue->_val.fval = (float)src(pi.op1)._val.ival;
                 }
                 else {
                     assert(0 && "in Operator::cvt_i2f, op1 has a wrong type");
                 }
-#if (DEBUG_EXEC_DETAIL)
-                    std::cout << "\tdes operand(" << toString(inst->des.type) << " " << inst->des.name  << "), value = " << pvalue->_val.fval << std::endl;
-#endif
             } break;
             case Operator::cvt_f2i: {
                 assert(inst->des.type == Type::Int);
-                auto pvalue = get_des_operand(inst->des);
+                auto pvalue = &des(pi.des);
                 if (IS_FLOAT_OPERAND(inst->op1)) {
-                    pvalue->_val.ival = (int)find_src_operand(inst->op1)._val.fval;
+                    pvalue->_val.ival = (int)src(pi.op1)._val.fval;
                 }
                 else {
                     assert(0 && "in Operator::cvt_f2i, op1 has a wrong type");
                 }
-#if (DEBUG_EXEC_DETAIL)
-                    std::cout << "\tdes operand(" << toString(inst->des.type) << " " << inst->des.name  << "), value = " << pvalue->_val.ival << std::endl;
-#endif
             } break;
             // 2 int operand
             case Operator::add: 
@@ -452,7 +538,7 @@ bool ir::Executor::exec_ir(size_t n) {
                 // op1
                 int v1;
                 if (IS_INT_OPERAND(inst->op1)) {
-                    v1 = find_src_operand(inst->op1)._val.ival;
+                    v1 = src(pi.op1)._val.ival;
                 }
                 else {
                     assert(0 && "type of op1 is not Type::Int or Type::IntLiteral");
@@ -460,12 +546,12 @@ bool ir::Executor::exec_ir(size_t n) {
                 // op2
                 int v2;
                 if (IS_INT_OPERAND(inst->op2)) {
-                    v2 = find_src_operand(inst->op2)._val.ival;
+                    v2 = src(pi.op2)._val.ival;
                 }
                 else {
                     assert(0 && "type of op2 is not Type::Int or Type::IntLiteral");
                 }
-                auto pvalue = get_des_operand(inst->des);
+                auto pvalue = &des(pi.des);
                 switch (inst->op) {
                     case Operator::add:
                         pvalue->_val.ival = v1 + v2;
@@ -509,18 +595,15 @@ bool ir::Executor::exec_ir(size_t n) {
                     default:
                         assert(0 && "should not reach hear!");
                 }
-#if (DEBUG_EXEC_DETAIL)
-                    std::cout << "\tdes operand(" << toString(inst->des.type) << " " << inst->des.name  << "), value = " << pvalue->_val.ival << std::endl;
-#endif
             } break;
             case Operator::addi: 
             case Operator::subi:
             {
-                int v1 = find_src_operand(inst->op1)._val.ival;
+                int v1 = src(pi.op1)._val.ival;
                 assert(inst->op1.type == Type::Int);
-                int v2 = eval_int(inst->op2.name);
+                int v2 = src(pi.op2)._val.ival;
                 assert((inst->op2.type == Type::IntLiteral));
-                get_des_operand(inst->des)->_val.ival = (inst->op == Operator::addi) ? v1 + v2 : v1 - v2;
+                des(pi.des)._val.ival = (inst->op == Operator::addi) ? v1 + v2 : v1 - v2;
             } break;
             case Operator::fadd:
             case Operator::fsub:
@@ -537,7 +620,7 @@ bool ir::Executor::exec_ir(size_t n) {
                 // op1
                 float v1;
                 if (IS_FLOAT_OPERAND(inst->op1)) {
-                    v1 = find_src_operand(inst->op1)._val.fval;
+                    v1 = src(pi.op1)._val.fval;
                 }
                 else {
                     assert(0 && "type of op1 is not Type::Int or Type::IntLiteral");
@@ -545,12 +628,12 @@ bool ir::Executor::exec_ir(size_t n) {
                 // op2
                 float v2;
                 if (IS_FLOAT_OPERAND(inst->op2)) {
-                    v2 = find_src_operand(inst->op2)._val.fval;
+                    v2 = src(pi.op2)._val.fval;
                 }
                 else {
                     assert(0 && "type of op2 is not Type::Int or Type::IntLiteral");
                 }
-                auto pvalue = get_des_operand(inst->des);
+                auto pvalue = &des(pi.des);
                 switch (inst->op) {
                     case Operator::fadd:
                         pvalue->_val.fval = v1 + v2;
@@ -585,9 +668,6 @@ bool ir::Executor::exec_ir(size_t n) {
                     default:
                         assert(0 && "should not reach hear!");
                 }
-#if (DEBUG_EXEC_DETAIL)
-                    std::cout << "\tdes operand(" << toString(inst->des.type) << " " << inst->des.name  << "), value = " << pvalue->_val.fval << std::endl;
-#endif
             } break;
         case Operator::__unuse__:
             break;
@@ -609,11 +689,12 @@ bool ir::Executor::exec_ir(size_t n) {
 }
 
 using frontend::get_lib_funcs;
-bool ir::Executor::exec_lib_function(const ir::CallInst* callinst, Value* p_retval) {
-    auto fn = callinst->op1.name;
-    if (get_lib_funcs()->find(fn) == get_lib_funcs()->end()) {
+bool ir::Executor::exec_lib_function(const PreparedInst& call, Value* p_retval) {
+    if (call.callee >= 0) {
         return false;
     }
+    auto callinst = call.inst;
+    auto fn = callinst->op1.name;
     switch (callinst->des.type) {
     case Type::Int: {
         p_retval->t = Type::Int;
@@ -624,12 +705,12 @@ bool ir::Executor::exec_lib_function(const ir::CallInst* callinst, Value* p_retv
             p_retval->_val.ival = getch();
         }
         else if (fn == "getarray") {
-            auto arr = find_src_operand(callinst->argumentList[0]);
+            auto arr = src(call.args[0]);
             assert(arr.t == Type::IntPtr && "argument do not match getarray(int*)");
             p_retval->_val.ival = getarray(arr._val.iptr);
         }
         else if (fn == "getfarray") {
-            auto arr = find_src_operand(callinst->argumentList[0]);
+            auto arr = src(call.args[0]);
             assert(arr.t == Type::FloatPtr && "argument do not match getfarray(float*)");
             p_retval->_val.ival = getfarray(arr._val.fptr);
         } 
@@ -643,7 +724,7 @@ bool ir::Executor::exec_lib_function(const ir::CallInst* callinst, Value* p_retv
         p_retval->_val.fval = getfloat();
     } break;
     case Type::null: {
-        auto arg1 = find_src_operand(callinst->argumentList[0]);
+        auto arg1 = src(call.args[0]);
         if (fn == "putint") {
             assert(arg1.t == Type::Int && "argument do not match putint(int)");
             putint(arg1._val.ival);
@@ -657,12 +738,12 @@ bool ir::Executor::exec_lib_function(const ir::CallInst* callinst, Value* p_retv
             putfloat(arg1._val.fval);
         }
         else if (fn == "putarray") {
-            auto arg2 = find_src_operand(callinst->argumentList[1]);
+            auto arg2 = src(call.args[1]);
             assert(arg1.t == Type::Int && arg2.t == Type::IntPtr && "argument do not match putarray(int,int*)");
             putarray(arg1._val.ival, arg2._val.iptr);
         }
         else if (fn == "putfarray") {
-            auto arg2 = find_src_operand(callinst->argumentList[1]);
+            auto arg2 = src(call.args[1]);
             assert(arg1.t == Type::Int && arg2.t == Type::FloatPtr && "argument do not match putfarray(int,float*)");
             putfarray(arg1._val.ival, arg2._val.fptr);
         }
@@ -683,62 +764,181 @@ FILE* ir::reopen_output_file = nullptr;
 FILE* ir::reopen_input_file = nullptr;
 
 /* Input & output functions */
+// the runtime reads the whole input file at the first get* and buffers the output of put*, 
+// numbers are parsed and formatted by hand, the results are the same as of fscanf/fprintf
+namespace {
+
+struct InputBuffer {
+    std::string data;
+    size_t pos = 0;
+    bool loaded = false;
+
+    void load() {
+        loaded = true;
+        if (!ir::reopen_input_file) return;
+        char buf[1 << 16];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), ir::reopen_input_file)) > 0) data.append(buf, n);
+    }
+
+    void skip_space() {
+        if (!loaded) load();
+        while (pos < data.size() && isspace((unsigned char)data[pos])) pos++;
+    }
+
+    // %d
+    int read_int() {
+        skip_space();
+        bool neg = false;
+        if (pos < data.size() && (data[pos] == '-' || data[pos] == '+')) neg = data[pos++] == '-';
+        uint32_t val = 0;
+        while (pos < data.size() && data[pos] >= '0' && data[pos] <= '9') val = val * 10 + (data[pos++] - '0');
+        return (int)(neg ? 0u - val : val);
+    }
+
+    // %c
+    int read_char() {
+        if (!loaded) load();
+        return pos < data.size() ? (int)data[pos++] : EOF;
+    }
+
+    // %a, which accepts the same as strtof
+    float read_float() {
+        skip_space();
+        const char* begin = data.c_str() + pos;
+        char* end;
+        float val = strtof(begin, &end);
+        pos += end - begin;
+        return val;
+    }
+} input;
+
+struct OutputBuffer {
+    char buf[1 << 16];
+    size_t len = 0;
+
+    void flush() {
+        if (len && ir::reopen_output_file) fwrite(buf, 1, len, ir::reopen_output_file);
+        len = 0;
+    }
+
+    void reserve(size_t n) {
+        if (len + n > sizeof(buf)) flush();
+    }
+
+    void put_char(char c) {
+        reserve(1);
+        buf[len++] = c;
+    }
+
+    // %d
+    void put_int(int a) {
+        char tmp[12];
+        int n = 0;
+        uint32_t val = a < 0 ? 0u - (uint32_t)a : (uint32_t)a;
+        do {
+            tmp[n++] = '0' + val % 10;
+            val /= 10;
+        } while (val);
+        reserve(n + 1);
+        if (a < 0) buf[len++] = '-';
+        while (n) buf[len++] = tmp[--n];
+    }
+
+    // %a of a float promoted to double, which is always 0 or normal: [-]0x1.<hex digits>p<+|-><exp>
+    void put_float(float a) {
+        double d = a;
+        if (std::isnan(d) || std::isinf(d)) {
+            char tmp[8];
+            int n = snprintf(tmp, sizeof(tmp), "%a", d);
+            reserve(n);
+            memcpy(buf + len, tmp, n);
+            len += n;
+            return;
+        }
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        reserve(32);
+        if (bits >> 63) buf[len++] = '-';
+        uint64_t mantissa = bits & ((1ull << 52) - 1);
+        int exp = (int)((bits >> 52) & 0x7ff);
+        buf[len++] = '0';
+        buf[len++] = 'x';
+        buf[len++] = exp ? '1' : '0';
+        exp = exp ? exp - 1023 : 0;
+        if (mantissa) {
+            buf[len++] = '.';
+            int digits = 13;
+            while (!(mantissa & 0xf)) {
+                mantissa >>= 4;
+                digits--;
+            }
+            for (int i = digits - 1; i >= 0; i--) buf[len++] = "0123456789abcdef"[(mantissa >> (4 * i)) & 0xf];
+        }
+        buf[len++] = 'p';
+        buf[len++] = exp < 0 ? '-' : '+';
+        put_int(exp < 0 ? -exp : exp);
+    }
+} output;
+
+} // namespace
+
+void ir::flush_output() {
+    output.flush();
+}
+
 int getint() {
-    int t; 
-    fscanf(ir::reopen_input_file, "%d",&t); 
-    return t; 
+    return input.read_int();
 }
 
 int getch() {
-    char c; 
-    fscanf(ir::reopen_input_file, "%c",&c); 
-    return (int)c; 
+    return input.read_char();
 }
 
 float getfloat(){
-    float n;
-    fscanf(ir::reopen_input_file, "%a", &n);
-    return n;
+    return input.read_float();
 }
 
 int getarray(int a[]){
-  int n;
-  fscanf(ir::reopen_input_file, "%d",&n);
-  for(int i=0;i<n;i++)fscanf(ir::reopen_input_file, "%d",&a[i]);
-  return n;
+    int n = input.read_int();
+    for (int i = 0; i < n; i++) a[i] = input.read_int();
+    return n;
 }
 
 int getfarray(float a[]) {
-    int n;
-    fscanf(ir::reopen_input_file, "%d", &n);
-    for (int i = 0; i < n; i++) {
-        fscanf(ir::reopen_input_file, "%a", &a[i]);
-    }
+    int n = input.read_int();
+    for (int i = 0; i < n; i++) a[i] = input.read_float();
     return n;
 }
 
 void putint(int a) { 
-    fprintf(ir::reopen_output_file, "%d",a);
+    output.put_int(a);
 }
 
 void putch(int a) {
-    fprintf(ir::reopen_output_file, "%c",a);
+    output.put_char((char)a);
 }
 
 void putarray(int n,int a[]){
-  fprintf(ir::reopen_output_file, "%d:",n);
-  for(int i=0;i<n;i++)fprintf(ir::reopen_output_file, " %d",a[i]);
-  fprintf(ir::reopen_output_file, "\n");
+    output.put_int(n);
+    output.put_char(':');
+    for (int i = 0; i < n; i++) {
+        output.put_char(' ');
+        output.put_int(a[i]);
+    }
+    output.put_char('\n');
 }
 
 void putfloat(float a) {
-  fprintf(ir::reopen_output_file, "%a", a);
+    output.put_float(a);
 }
 
 void putfarray(int n, float a[]) {
-    fprintf(ir::reopen_output_file, "%d:", n);
+    output.put_int(n);
+    output.put_char(':');
     for (int i = 0; i < n; i++) {
-        fprintf(ir::reopen_output_file, " %a", a[i]);
+        output.put_char(' ');
+        output.put_float(a[i]);
     }
-    fprintf(ir::reopen_output_file, "\n");
+    output.put_char('\n');
 }
@@ -0,0 +1,114 @@
+#include"tools/ir_executor.h"
+#include"json/json.h"
+
+#include<map>
+#include<cstdio>
+#include<algorithm>
+
+namespace {
+
+// entries shown in each table of the report
+const size_t report_rows = 10;
+
+double percent(uint64_t n, uint64_t total) {
+    return total ? 100.0 * n / total : 0;
+}
+
+} // namespace
+
+void ir::Executor::write_profile_report(std::ostream& os) const {
+    char line[256];
+    uint64_t total = 0;
+    std::vector<uint64_t> func_total(functions.size(), 0);
+    for (size_t i = 0; i < profile.size(); i++) {
+        for (auto n: profile[i].counts) func_total[i] += n;
+        total += func_total[i];
+    }
+    os << "executed instructions: " << total << "\n";
+
+    // functions by executed instructions
+    std::vector<size_t> order;
+    for (size_t i = 0; i < profile.size(); i++) {
+        if (profile[i].calls) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return func_total[a] > func_total[b]; });
+    os << "\nhottest functions\n";
+    snprintf(line, sizeof(line), "%-24s %12s %14s %8s\n", "function", "calls", "insts", "%");
+    os << line;
+    for (size_t k = 0; k < order.size() && k < report_rows; k++) {
+        auto i = order[k];
+        snprintf(line, sizeof(line), "%-24s %12llu %14llu %8.2f\n", functions[i].pfunc->name.c_str(),
+            (unsigned long long)profile[i].calls, (unsigned long long)func_total[i], percent(func_total[i], total));
+        os << line;
+    }
+
+    // a _goto jumping backwards closes a loop, its body is [target, pc]
+    struct LoopEntry { size_t func, head, latch; uint64_t trips, insts; };
+    std::vector<LoopEntry> loops;
+    for (size_t i = 0; i < profile.size(); i++) {
+        const auto& insts = functions[i].insts;
+        for (size_t pc = 0; pc < insts.size(); pc++) {
+            if (insts[pc].op != Operator::_goto || insts[pc].target > pc || !profile[i].taken[pc]) continue;
+            uint64_t body = 0;
+            for (size_t j = insts[pc].target; j <= pc; j++) body += profile[i].counts[j];
+            loops.push_back({i, (size_t)insts[pc].target, pc, profile[i].taken[pc], body});
+        }
+    }
+    std::sort(loops.begin(), loops.end(), [](const LoopEntry& a, const LoopEntry& b) { return a.insts > b.insts; });
+    os << "\nhottest loops\n";
+    snprintf(line, sizeof(line), "%-24s %12s %14s %14s %8s\n", "function", "pc", "back edges", "insts", "%");
+    os << line;
+    for (size_t k = 0; k < loops.size() && k < report_rows; k++) {
+        const auto& l = loops[k];
+        auto range = std::to_string(l.head) + "-" + std::to_string(l.latch);
+        snprintf(line, sizeof(line), "%-24s %12s %14llu %14llu %8.2f\n", functions[l.func].pfunc->name.c_str(), range.c_str(),
+            (unsigned long long)l.trips, (unsigned long long)l.insts, percent(l.insts, total));
+        os << line;
+    }
+
+    // instruction mix by operator
+    std::map<Operator, uint64_t> mix;
+    for (size_t i = 0; i < profile.size(); i++) {
+        for (size_t pc = 0; pc < functions[i].insts.size(); pc++) mix[functions[i].insts[pc].op] += profile[i].counts[pc];
+    }
+    std::vector<std::pair<Operator, uint64_t>> ops(mix.begin(), mix.end());
+    std::sort(ops.begin(), ops.end(), [](const std::pair<Operator, uint64_t>& a, const std::pair<Operator, uint64_t>& b) {
+        return a.second > b.second;
+    });
+    os << "\ninstruction mix\n";
+    snprintf(line, sizeof(line), "%-24s %14s %8s\n", "operator", "count", "%");
+    os << line;
+    for (const auto& p: ops) {
+        if (!p.second) continue;
+        snprintf(line, sizeof(line), "%-24s %14llu %8.2f\n", toString(p.first).c_str(), (unsigned long long)p.second, percent(p.second, total));
+        os << line;
+    }
+}
+
+void ir::Executor::write_profile(std::ostream& os) const {
+    Json::Value root;
+    root["version"] = 1;
+    root["functions"] = Json::Value(Json::arrayValue);
+    for (size_t i = 0; i < profile.size(); i++) {
+        const auto& insts = functions[i].insts;
+        Json::Value func;
+        func["name"] = functions[i].pfunc->name;
+        func["calls"] = Json::UInt64(profile[i].calls);
+        func["counts"] = Json::Value(Json::arrayValue);
+        func["gotos"] = Json::Value(Json::arrayValue);
+        for (size_t pc = 0; pc < insts.size(); pc++) {
+            func["counts"].append(Json::UInt64(profile[i].counts[pc]));
+            if (insts[pc].op != Operator::_goto) continue;
+            Json::Value edge;
+            edge["pc"] = Json::UInt64(pc);
+            edge["target"] = Json::UInt64(insts[pc].target);
+            edge["taken"] = Json::UInt64(profile[i].taken[pc]);
+            edge["not_taken"] = Json::UInt64(profile[i].counts[pc] - profile[i].taken[pc]);
+            func["gotos"].append(edge);
+        }
+        root["functions"].append(func);
+    }
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    os << Json::writeString(builder, root) << "\n";
+}
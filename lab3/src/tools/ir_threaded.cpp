@@ -0,0 +1,263 @@
+#include"tools/ir_executor.h"
+
+#include<set>
+#include<cassert>
+
+// dispatch by GCC's computed goto (labels as values), define EXEC_NO_COMPUTED_GOTO to use the portable switch
+#if defined(__GNUC__) && !defined(EXEC_NO_COMPUTED_GOTO)
+#define EXEC_COMPUTED_GOTO 1
+#else
+#define EXEC_COMPUTED_GOTO 0
+#endif
+
+using ir::Type;
+using ir::Operator;
+
+namespace {
+
+// handlers without operand variants
+#define EXEC_SIMPLE_OPS(X) \
+    X(generic) X(mov) X(li) X(lnot) X(jump) X(branch) \
+    X(load_r) X(load_i) X(gload_r) X(gload_i) X(store_r) X(store_i) X(gstore_r) X(gstore_i)
+// int compare, each has a reg/reg and a reg/imm handler, and compare-and-branch superinstructions
+#define EXEC_CMP_OPS(X) X(lss, <) X(leq, <=) X(gtr, >) X(geq, >=) X(eq, ==) X(neq, !=)
+// int binary operators, each has a reg/reg and a reg/imm handler
+#define EXEC_BINARY_OPS(X) X(add, +) X(sub, -) X(mul, *) X(div, /) X(mod, %) EXEC_CMP_OPS(X)
+
+// op_x_ri follows op_x_rr, for a compare op_br_x_rr, op_br_x_ri, op_brn_x_rr, op_brn_x_ri follow each other
+enum Opcode {
+#define SIMPLE_OPCODE(name) op_##name,
+#define BINARY_OPCODE(name, sym) op_##name##_rr, op_##name##_ri,
+#define CMP_OPCODE(name, sym) op_br_##name##_rr, op_br_##name##_ri, op_brn_##name##_rr, op_brn_##name##_ri,
+    EXEC_SIMPLE_OPS(SIMPLE_OPCODE)
+    EXEC_BINARY_OPS(BINARY_OPCODE)
+    EXEC_CMP_OPS(CMP_OPCODE)
+#undef SIMPLE_OPCODE
+#undef BINARY_OPCODE
+#undef CMP_OPCODE
+    op_count
+};
+
+int binary_opcode(Operator op) {
+    switch (op) {
+#define BINARY_CASE(name, sym) case Operator::name: return op_##name##_rr;
+        EXEC_BINARY_OPS(BINARY_CASE)
+#undef BINARY_CASE
+        case Operator::addi: return op_add_rr;
+        case Operator::subi: return op_sub_rr;
+        default: return -1;
+    }
+}
+
+int branch_opcode(Operator op) {
+    switch (op) {
+#define CMP_CASE(name, sym) case Operator::name: return op_br_##name##_rr;
+        EXEC_CMP_OPS(CMP_CASE)
+#undef CMP_CASE
+        default: return -1;
+    }
+}
+
+// imm op x is computed as x op' imm
+Operator swap_operands(Operator op) {
+    switch (op) {
+        case Operator::add: case Operator::mul: case Operator::eq: case Operator::neq: return op;
+        case Operator::lss: return Operator::gtr;
+        case Operator::leq: return Operator::geq;
+        case Operator::gtr: return Operator::lss;
+        case Operator::geq: return Operator::leq;
+        default: return Operator::__unuse__;
+    }
+}
+
+bool is_int(const ir::Operand& op) {
+    return op.type == Type::Int || op.type == Type::IntLiteral;
+}
+
+} // namespace
+
+void ir::Executor::translate(PreparedFunction& pf) {
+    std::set<uint32_t> targets;
+    for (const auto& pi: pf.insts) {
+        if (pi.op == Operator::_goto) targets.insert(pi.target);
+    }
+    auto local = [](const Slot& s) { return s.kind == Slot::local; };
+    auto imm = [](const Slot& s) { return s.kind == Slot::imm; };
+
+    pf.code.assign(pf.insts.size(), Code{});
+    for (size_t pc = 0; pc < pf.insts.size(); pc++) {
+        const auto& pi = pf.insts[pc];
+        auto inst = pi.inst;
+        auto& c = pf.code[pc];
+        c.opcode = op_generic;
+        c.des = pi.des.index;
+        c.op1 = pi.op1.index;
+        c.op2 = pi.op2.index;
+        c.target = pi.target;
+
+        switch (pi.op) {
+            case Operator::def: case Operator::mov:
+            case Operator::fdef: case Operator::fmov: {
+                bool is_float = pi.op == Operator::fdef || pi.op == Operator::fmov;
+                Type var = is_float ? Type::Float : Type::Int, lit = is_float ? Type::FloatLiteral : Type::IntLiteral;
+                if (!local(pi.des) || inst->des.type != var) break;
+                if (local(pi.op1) && inst->op1.type == var) {
+                    c.opcode = op_mov;
+                }
+                else if (imm(pi.op1) && inst->op1.type == lit) {
+                    c.opcode = op_li;
+                    c.imm = pi.op1.val._val;
+                }
+            } break;
+            case Operator::_not:
+                if (local(pi.des) && local(pi.op1) && inst->des.type == Type::Int && inst->op1.type == Type::Int) c.opcode = op_lnot;
+                break;
+            case Operator::_goto:
+                if (pi.op1.kind == Slot::none) c.opcode = op_jump;
+                else if (local(pi.op1) && inst->op1.type == Type::Int) c.opcode = op_branch;
+                break;
+            case Operator::load: case Operator::store: {
+                // int arrays only, the value of a store has to be a variable
+                if (inst->op1.type != Type::IntPtr || !is_int(inst->op2) || !local(pi.des) || !is_int(inst->des)) break;
+                if (!local(pi.op2) && !imm(pi.op2)) break;
+                bool idx_imm = imm(pi.op2);
+                if (idx_imm) c.imm = pi.op2.val._val;
+                if (local(pi.op1)) {
+                    if (pi.op == Operator::load) c.opcode = idx_imm ? op_load_i : op_load_r;
+                    else c.opcode = idx_imm ? op_store_i : op_store_r;
+                }
+                else if (pi.op1.kind == Slot::global) {
+                    c.gvar = &global_vars[pi.op1.index];
+                    if (pi.op == Operator::load) c.opcode = idx_imm ? op_gload_i : op_gload_r;
+                    else c.opcode = idx_imm ? op_gstore_i : op_gstore_r;
+                }
+            } break;
+            default: {
+                int rr = binary_opcode(pi.op);
+                if (rr < 0 || !local(pi.des) || inst->des.type != Type::Int || !is_int(inst->op1) || !is_int(inst->op2)) break;
+                Operator op = pi.op;
+                const Slot *a = &pi.op1, *b = &pi.op2;
+                if (imm(*a) && local(*b)) {
+                    op = swap_operands(op);
+                    if (op == Operator::__unuse__) break;
+                    std::swap(a, b);
+                    rr = binary_opcode(op);
+                }
+                if (!local(*a) || (!local(*b) && !imm(*b))) break;
+                c.op1 = a->index;
+                c.op2 = b->index;
+                bool ri = imm(*b);
+                if (ri) c.imm = b->val._val;
+                c.opcode = rr + ri;
+
+                // compare-and-branch: `cmp t; if t goto`, or `cmp t; not u, t; if u goto`
+                int br = branch_opcode(op);
+                if (br < 0) break;
+                auto next = [&](size_t k) -> const PreparedInst* {
+                    return pc + k < pf.insts.size() && !targets.count(pc + k) ? &pf.insts[pc + k] : nullptr;
+                };
+                auto n1 = next(1);
+                if (n1 && n1->op == Operator::_goto && local(n1->op1) && n1->op1.index == c.des) {
+                    c.opcode = br + ri;
+                    c.target = n1->target;
+                }
+                else if (n1 && n1->op == Operator::_not && local(n1->op1) && n1->op1.index == c.des && local(n1->des)) {
+                    auto n2 = next(2);
+                    if (n2 && n2->op == Operator::_goto && local(n2->op1) && n2->op1.index == n1->des.index) {
+                        c.opcode = br + 2 + ri;
+                        c.des2 = n1->des.index;
+                        c.target = n2->target;
+                    }
+                }
+            } break;
+        }
+    }
+}
+
+void ir::Executor::run_threaded() {
+#if (EXEC_COMPUTED_GOTO)
+    static const void* const labels[op_count] = {
+#define SIMPLE_LABEL(name) &&L_##name,
+#define BINARY_LABEL(name, sym) &&L_##name##_rr, &&L_##name##_ri,
+#define CMP_LABEL(name, sym) &&L_br_##name##_rr, &&L_br_##name##_ri, &&L_brn_##name##_rr, &&L_brn_##name##_ri,
+        EXEC_SIMPLE_OPS(SIMPLE_LABEL)
+        EXEC_BINARY_OPS(BINARY_LABEL)
+        EXEC_CMP_OPS(CMP_LABEL)
+#undef SIMPLE_LABEL
+#undef BINARY_LABEL
+#undef CMP_LABEL
+    };
+    for (auto& pf: functions) {
+        for (auto& c: pf.code) c.label = labels[c.opcode];
+    }
+#define HANDLER(name) L_##name:
+#define NEXT() goto *const_cast<void*>(code[pc].label)
+#else
+#define HANDLER(name) case op_##name:
+#define NEXT() break
+#endif
+
+    const Code* code = nullptr;
+    Value* fp = nullptr;
+    uint32_t pc = 0;
+#define LOAD_CONTEXT() code = cur_ctx->prepared->code.data(); fp = stack.data() + cur_ctx->base; pc = cur_ctx->pc
+#define C code[pc]
+#define I(slot) fp[slot]._val.ival
+
+    LOAD_CONTEXT();
+#if (EXEC_COMPUTED_GOTO)
+    NEXT();
+#else
+    while (true) {
+    switch (C.opcode) {
+#endif
+
+    HANDLER(generic) {
+        // call, return and the instructions without a specialised handler
+        cur_ctx->pc = pc;
+        exec_ir();
+        if (!cur_ctx) return;
+        LOAD_CONTEXT();
+    } NEXT();
+    HANDLER(mov) { fp[C.des]._val = fp[C.op1]._val; pc++; } NEXT();
+    HANDLER(li) { fp[C.des]._val = C.imm; pc++; } NEXT();
+    HANDLER(lnot) { I(C.des) = I(C.op1) == 0; pc++; } NEXT();
+    HANDLER(jump) { pc = C.target; } NEXT();
+    HANDLER(branch) { pc = I(C.op1) ? C.target : pc + 1; } NEXT();
+    HANDLER(load_r) { I(C.des) = fp[C.op1]._val.iptr[I(C.op2)]; pc++; } NEXT();
+    HANDLER(load_i) { I(C.des) = fp[C.op1]._val.iptr[C.imm.ival]; pc++; } NEXT();
+    HANDLER(gload_r) { I(C.des) = C.gvar->_val.iptr[I(C.op2)]; pc++; } NEXT();
+    HANDLER(gload_i) { I(C.des) = C.gvar->_val.iptr[C.imm.ival]; pc++; } NEXT();
+    HANDLER(store_r) { fp[C.op1]._val.iptr[I(C.op2)] = I(C.des); pc++; } NEXT();
+    HANDLER(store_i) { fp[C.op1]._val.iptr[C.imm.ival] = I(C.des); pc++; } NEXT();
+    HANDLER(gstore_r) { C.gvar->_val.iptr[I(C.op2)] = I(C.des); pc++; } NEXT();
+    HANDLER(gstore_i) { C.gvar->_val.iptr[C.imm.ival] = I(C.des); pc++; } NEXT();
+
+#define BINARY_HANDLER(name, sym) \
+    HANDLER(name##_rr) { I(C.des) = I(C.op1) sym I(C.op2); pc++; } NEXT(); \
+    HANDLER(name##_ri) { I(C.des) = I(C.op1) sym C.imm.ival; pc++; } NEXT();
+    EXEC_BINARY_OPS(BINARY_HANDLER)
+#undef BINARY_HANDLER
+
+    // the compare (and not) results are still written, they may be used after the branch
+#define CMP_HANDLER(name, sym) \
+    HANDLER(br_##name##_rr) { int v = I(C.op1) sym I(C.op2); I(C.des) = v; pc = v ? C.target : pc + 2; } NEXT(); \
+    HANDLER(br_##name##_ri) { int v = I(C.op1) sym C.imm.ival; I(C.des) = v; pc = v ? C.target : pc + 2; } NEXT(); \
+    HANDLER(brn_##name##_rr) { int v = I(C.op1) sym I(C.op2); I(C.des) = v; I(C.des2) = !v; pc = v ? pc + 3 : C.target; } NEXT(); \
+    HANDLER(brn_##name##_ri) { int v = I(C.op1) sym C.imm.ival; I(C.des) = v; I(C.des2) = !v; pc = v ? pc + 3 : C.target; } NEXT();
+    EXEC_CMP_OPS(CMP_HANDLER)
+#undef CMP_HANDLER
+
+#if (!EXEC_COMPUTED_GOTO)
+    default:
+        assert(0 && "unknown opcode");
+    }
+    }
+#endif
+
+#undef HANDLER
+#undef NEXT
+#undef LOAD_CONTEXT
+#undef C
+#undef I
+}
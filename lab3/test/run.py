@@ -43,6 +43,11 @@ def run_compiler(arg1):
             for src in src_files:
                 fname, ftype = src.split('.')
                 cmd = ' '.join([compiler_path, testcase_dir + src, step, "-o", output_dir + fname + "." + oftype])
+                # extra options of a testcase, e.g. the passes it checks, are in <name>.opt
+                opt_file = testcase_dir + fname + ".opt"
+                if os.path.exists(opt_file):
+                    with open(opt_file) as f:
+                        cmd = ' '.join([cmd, f.read().strip()])
                 if is_windows:
                     cmd = cmd.replace('/','\\')
                 cp = subprocess.run(cmd, shell=True, stderr=subprocess.PIPE, stdout=subprocess.DEVNULL)
@@ -1,4 +1,25 @@
-import os, platform, subprocess, shutil, sys
+import os, platform, subprocess, shutil, sys, re
+
+# each line of check_file is `<function> <regex>` or `<function> !<regex>`, the regex must (not) be found
+# in the assembly of the function, up to the next label which is not one of its own;
+# returns the first line which fails, or None
+def check_asm(asm_file, check_file):
+    with open(asm_file) as f:
+        lines = f.read().splitlines()
+    with open(check_file) as f:
+        checks = [l.split(None, 1) for l in f.read().splitlines() if l.strip()]
+    for func, pattern in checks:
+        body, inside = [], False
+        for l in lines:
+            if re.match(r"^[\w.]+:", l):
+                inside = l == func + ":" or (inside and l.startswith(func + "_"))
+            elif inside:
+                body.append(l)
+        negate = pattern.startswith("!")
+        found = any(re.search(pattern[negate:], l) for l in body)
+        if not body or found == negate:
+            return func + " " + pattern
+    return None
 
 def score_compiler(arg1):
     record = {}
@@ -27,7 +48,10 @@ def score_compiler(arg1):
     ref_base = "./ref/" + arg1 + "/"
 
     score = 0
-    total = 58      # FIXME 改成读取测试用例数而不是写死
+    total = 0
+    for i in ["basic", "function"]:
+        if os.path.exists(testcase_base + i):
+            total += len([f for f in os.listdir(testcase_base + i) if f[-3:] == ".sy"])
 
     if step == "-s0":
         for i in ["basic", "function"]:
@@ -102,9 +126,18 @@ def score_compiler(arg1):
                     if not (file[-2:] == ".s"):
                         continue
                     print("compiling", file)
+                    fname, ftype = file.split('.')
+
+                    # patterns a testcase expects in its assembly, e.g. that a function has no frame, are in <name>.check
+                    check_file = testcase_dir + fname + ".check"
+                    if os.path.exists(check_file):
+                        failed = check_asm(output_dir + file, check_file)
+                        if failed:
+                            record[file] = {"retval": -1, "err_detail": "assembly check [" + failed + "] failed"}
+                            print(record[file])
+                            continue
 
                     # gcc
-                    fname, ftype = file.split('.')
                     ref_file = ref_dir + fname + ".out"
                     output_file = output_dir + fname + ".out" 
                     exec_file = output_dir + fname + ".exe"
@@ -116,6 +149,9 @@ def score_compiler(arg1):
                 
                     # qemu 
                     cmd = ' '.join(["qemu-riscv32.sh", exec_file])
+                    # a fixed 8 MiB stack, deep recursion which is not turned into loops overflows it
+                    if not is_windows:
+                        cmd = ' '.join(["ulimit -s 8192 &&", cmd])
                     input_file = testcase_dir + fname + ".in"
                     if os.path.exists(input_file):
                         cmd = ' '.join([cmd, "<", input_file])